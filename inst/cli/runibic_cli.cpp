@@ -0,0 +1,377 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+/* runibic without R: reads a matrix, runs the same steps as runibic() and writes the biclusters
+
+   Input is a tab separated text matrix, or with -b a binary file made of two int32 values
+   (number of rows and columns) followed by the values as float64 stored row by row,
+   or with -M a sparse Matrix Market coordinate file, which is never expanded to a dense matrix.
+   Output has one line per bicluster with its size and the 1-based indices (or names with -H)
+   of its rows and columns separated by commas. */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Unibic.h"
+#include "BlockStream.h"
+
+using namespace std;
+
+struct Matrix {
+  int nrow = 0;
+  int ncol = 0;
+  vector<double> values; // column-major, or the stored entries of a sparse matrix
+  vector<int> colStart; // entries of column j of a sparse matrix are [colStart[j], colStart[j+1])
+  vector<int> rows;
+  vector<string> rowNames;
+  vector<string> colNames;
+};
+
+static void usage() {
+  cerr << "usage: runibic [options] input output\n"
+       << "  -t <t>       consistency level of the block (0.5-1.0], default 0.95\n"
+       << "  -q <q>       quantile used for discretization, default 0\n"
+       << "  -f <f>       filtering of overlapping blocks, default 1\n"
+       << "  -n <nbic>    maximum number of biclusters, default 100\n"
+       << "  -d <div>     number of ranks of discretization, default 0 (ncol)\n"
+       << "  -l           legacy parameter settings\n"
+       << "  -p <threads> number of threads, default 0 (OMP_NUM_THREADS)\n"
+       << "  -c <dir>     directory of the cache of pairwise LCS\n"
+       << "  -D           the input is already discrete\n"
+       << "  -b           binary input\n"
+       << "  -M           sparse input in the Matrix Market coordinate format\n"
+       << "  -H           text input has a header line and row names\n"
+       << "  -s <file>    append every block to a binary file as soon as it is found\n"
+       << "  -m <mb>      memory available to each stage in megabytes, default 0 (no limit)\n"
+       << "  -T <file>    write a Chrome trace (JSON) of the stages, seeds and threads\n"
+       << "output - writes to the standard output\n";
+}
+
+static bool parseValue(string const &field, double &value) {
+  if (field == "NA" || field == "NaN" || field == "nan") {
+    value = NAN;
+    return true;
+  }
+  char *end = NULL;
+  value = strtod(field.c_str(), &end);
+  return end != field.c_str() && *end == '\0';
+}
+
+static bool readText(string const &path, bool header, Matrix &m) {
+  ifstream in(path.c_str());
+  if (!in)
+    return false;
+  vector<vector<double>> rows;
+  string line, field;
+  bool first = true;
+  while (getline(in, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty())
+      continue;
+    istringstream fields(line);
+    if (header && first) {
+      first = false;
+      while (getline(fields, field, '\t'))
+        m.colNames.push_back(field);
+      continue;
+    }
+    first = false;
+    vector<double> row;
+    bool name = header;
+    while (getline(fields, field, '\t')) {
+      if (name) {
+        m.rowNames.push_back(field);
+        name = false;
+        continue;
+      }
+      double value;
+      if (!parseValue(field, value)) {
+        cerr << "runibic: not a number '" << field << "' in " << path << "\n";
+        return false;
+      }
+      row.push_back(value);
+    }
+    if (!rows.empty() && row.size() != rows[0].size()) {
+      cerr << "runibic: rows of " << path << " have different lengths\n";
+      return false;
+    }
+    rows.push_back(row);
+  }
+  m.nrow = rows.size();
+  m.ncol = rows.empty() ? 0 : rows[0].size();
+  // the header may or may not have a field above the row names
+  if (header && m.colNames.size() == static_cast<size_t>(m.ncol) + 1)
+    m.colNames.erase(m.colNames.begin());
+  m.values.resize(static_cast<size_t>(m.nrow) * m.ncol);
+  for (auto i = 0; i < m.nrow; i++)
+    for (auto j = 0; j < m.ncol; j++)
+      m.values[i + static_cast<size_t>(j) * m.nrow] = rows[i][j];
+  return true;
+}
+
+static bool readBinary(string const &path, Matrix &m) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL)
+    return false;
+  int32_t dims[2];
+  bool ok = fread(dims, sizeof(int32_t), 2, f) == 2 && dims[0] >= 0 && dims[1] >= 0;
+  if (ok) {
+    m.nrow = dims[0];
+    m.ncol = dims[1];
+    vector<double> row(m.ncol);
+    m.values.resize(static_cast<size_t>(m.nrow) * m.ncol);
+    for (auto i = 0; ok && i < m.nrow; i++) {
+      ok = fread(row.data(), sizeof(double), m.ncol, f) == static_cast<size_t>(m.ncol);
+      for (auto j = 0; ok && j < m.ncol; j++)
+        m.values[i + static_cast<size_t>(j) * m.nrow] = row[j];
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+/* general real, integer or pattern Matrix Market coordinate file, stored column by column with the rows of a column ascending */
+static bool readMatrixMarket(string const &path, Matrix &m) {
+  ifstream in(path.c_str());
+  string line, tag, object, format, field, symmetry;
+  if (!getline(in, line))
+    return false;
+  transform(line.begin(), line.end(), line.begin(), ::tolower);
+  istringstream banner(line);
+  banner >> tag >> object >> format >> field >> symmetry;
+  if (tag != "%%matrixmarket" || object != "matrix" || format != "coordinate" || symmetry != "general"
+      || (field != "real" && field != "integer" && field != "pattern")) {
+    cerr << "runibic: " << path << " is not a general real, integer or pattern Matrix Market coordinate file\n";
+    return false;
+  }
+  while (getline(in, line) && (line.empty() || line[0] == '%'))
+    ;
+  long long entries = -1;
+  istringstream size(line);
+  if (!(size >> m.nrow >> m.ncol >> entries) || m.nrow < 0 || m.ncol < 0 || entries < 0 || entries > INT32_MAX)
+    return false;
+  vector<int> rows(entries), cols(entries);
+  vector<double> values(entries, 1.0);
+  m.colStart.assign(m.ncol + 1, 0);
+  for (long long k = 0; k < entries; k++) {
+    if (!(in >> rows[k] >> cols[k]) || (field != "pattern" && !(in >> values[k]))
+        || rows[k] < 1 || rows[k] > m.nrow || cols[k] < 1 || cols[k] > m.ncol) {
+      cerr << "runibic: invalid entry " << k + 1 << " in " << path << "\n";
+      return false;
+    }
+    m.colStart[cols[k]]++;
+  }
+  for (auto j = 0; j < m.ncol; j++)
+    m.colStart[j + 1] += m.colStart[j];
+  vector<pair<int, double>> sorted(entries);
+  vector<int> next(m.colStart.begin(), m.colStart.end() - 1);
+  for (long long k = 0; k < entries; k++)
+    sorted[next[cols[k] - 1]++] = make_pair(rows[k] - 1, values[k]);
+  m.rows.resize(entries);
+  m.values.resize(entries);
+  for (auto j = 0; j < m.ncol; j++) {
+    sort(sorted.begin() + m.colStart[j], sorted.begin() + m.colStart[j + 1]);
+    for (auto k = m.colStart[j]; k < m.colStart[j + 1]; k++) {
+      if (k > m.colStart[j] && sorted[k].first == sorted[k - 1].first) {
+        cerr << "runibic: entry " << sorted[k].first + 1 << ", " << j + 1 << " is repeated in " << path << "\n";
+        return false;
+      }
+      m.rows[k] = sorted[k].first;
+      m.values[k] = sorted[k].second;
+    }
+  }
+  return true;
+}
+
+static void writeIndices(ostream &out, vector<int> indices, vector<string> const &names) {
+  sort(indices.begin(), indices.end());
+  for (size_t k = 0; k < indices.size(); k++) {
+    if (k > 0)
+      out << ',';
+    if (names.empty())
+      out << indices[k] + 1;
+    else
+      out << names[indices[k]];
+  }
+}
+
+static void setParams(double t, double q, double f, int nbic, int div, bool useLegacy, int nthreads, string const &cacheDir, double maxMemory) {
+  gParameters.Tolerance = t;
+  gParameters.Quantile = q;
+  gParameters.Filter = f;
+  gParameters.RptBlock = nbic;
+  gParameters.SchBlock = 2*gParameters.RptBlock;
+  gParameters.Divided = div;
+  gParameters.UseLegacy = useLegacy;
+  gParameters.Threads = nthreads;
+  gParameters.CacheDir = cacheDir;
+  gParameters.MaxMemory = static_cast<size_t>(maxMemory * 1048576);
+}
+
+static double megabytes(size_t bytes) {
+  return round(bytes / 104857.6) / 10;
+}
+
+/* prints the error of a stage which does not fit in the memory limit */
+static bool fitsMemory(const char *stage, size_t bytes) {
+  string message = memoryError(stage, bytes, gParameters);
+  if (!message.empty())
+    cerr << "runibic: " << message << "\n";
+  return message.empty();
+}
+
+int main(int argc, char **argv) {
+  double t = 0.95, q = 0, f = 1, maxMemory = 0;
+  int nbic = 100, div = 0, nthreads = 0;
+  bool useLegacy = false, discrete = false, binary = false, header = false, sparse = false;
+  string cacheDir, streamPath, tracePath;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:q:f:n:d:lp:c:DbMHs:m:T:h")) != -1) {
+    switch (opt) {
+      case 't': t = atof(optarg); break;
+      case 'q': q = atof(optarg); break;
+      case 'f': f = atof(optarg); break;
+      case 'n': nbic = atoi(optarg); break;
+      case 'd': div = atoi(optarg); break;
+      case 'l': useLegacy = true; break;
+      case 'p': nthreads = atoi(optarg); break;
+      case 'c': cacheDir = optarg; break;
+      case 'D': discrete = true; break;
+      case 'b': binary = true; break;
+      case 'M': sparse = true; break;
+      case 'H': header = true; break;
+      case 's': streamPath = optarg; break;
+      case 'm': maxMemory = atof(optarg); break;
+      case 'T': tracePath = optarg; break;
+      default: usage(); return opt == 'h' ? 0 : 2;
+    }
+  }
+  if (argc - optind != 2 || (sparse && (binary || header || discrete))) {
+    usage();
+    return 2;
+  }
+  string inputPath = argv[optind], outputPath = argv[optind + 1];
+
+  Matrix x;
+  if (!(sparse ? readMatrixMarket(inputPath, x) : binary ? readBinary(inputPath, x) : readText(inputPath, header, x))) {
+    cerr << "runibic: could not read " << inputPath << "\n";
+    return 1;
+  }
+  int nr = x.nrow, nc = x.ncol;
+  if (!gTrace.start(tracePath)) {
+    cerr << "runibic: could not write " << tracePath << "\n";
+    return 1;
+  }
+
+  // the steps of runibic() and runibic_d(), a sparse matrix is discretized and clustered from its stored entries
+  setParams(t, q, f, nbic, div, useLegacy, nthreads, cacheDir, maxMemory);
+  vector<int> discreteValues, sortedIndex;
+  SparseRowMatrix sparseValues;
+  if (sparse)
+    discretizeSparse(SparseColumnView(nr, nc, x.colStart.data(), x.rows.data(), x.values.data()), sparseValues);
+  else {
+    discreteValues.resize(x.values.size());
+    MatrixView<int> values(discreteValues.data(), nr, nc);
+    if (discrete) {
+      for (size_t k = 0; k < x.values.size(); k++)
+        discreteValues[k] = static_cast<int>(x.values[k]);
+    }
+    else
+      discretizeMatrix(MatrixView<const double>(x.values.data(), nr, nc), values);
+  }
+  setParams(t, q, f, nbic, div, useLegacy, nthreads, cacheDir, maxMemory);
+
+  if (!sparse) {
+    sortedIndex.resize(discreteValues.size());
+    MatrixView<int> index(sortedIndex.data(), nr, nc);
+    sortRowIndices(MatrixView<const int>(discreteValues.data(), nr, nc), index);
+  }
+  StageMemory need = sparse ? estimateMemory(sparseValues, gParameters, true) : estimateMemory(nr, nc, gParameters, true);
+  if (!fitsMemory("pair", need.Input + need.Pairs) || !fitsMemory("cluster", need.Input + need.Cluster + need.Output))
+    return 1;
+  vector<triple> seeds;
+  string cachePath;
+  bool written = sparse ? lcsAllPairs(sparseValues, true, seeds, cachePath)
+                        : lcsAllPairs(MatrixView<const int>(discreteValues.data(), nr, nc), true, seeds, cachePath);
+  if (!written)
+    cerr << "runibic: could not write the LCS cache file " << cachePath << "\n";
+
+  BlockFileWriter stream;
+  vector<BlockSink*> sinks;
+  if (!streamPath.empty()) {
+    if (!stream.open(streamPath)) {
+      cerr << "runibic: could not write " << streamPath << "\n";
+      return 1;
+    }
+    sinks.push_back(&stream);
+  }
+  gParameters.InitOptions(nr, nc);
+  vector<Params> settings(1, gParameters);
+  vector<vector<BicBlock*>> outputs;
+  vector<ClusterStats> stats;
+  if (sparse)
+    clusterSettings(settings, sparseValues, seeds, outputs, stats, sinks);
+  else
+    clusterSettings(settings, MatrixView<const int>(sortedIndex.data(), nr, nc), MatrixView<const int>(discreteValues.data(), nr, nc),
+                    seeds, nr, nc, outputs, stats, sinks);
+  if (!stream.close())
+    cerr << "runibic: could not write " << streamPath << "\n";
+
+  ofstream file;
+  if (outputPath != "-") {
+    file.open(outputPath.c_str());
+    if (!file) {
+      cerr << "runibic: could not write " << outputPath << "\n";
+      return 1;
+    }
+  }
+  ostream &out = outputPath == "-" ? cout : file;
+  out << "bicluster\trows\tcolumns\trowIndices\tcolumnIndices\n";
+  vector<BicBlock*> &blocks = outputs[0];
+  for (size_t b = 0; b < blocks.size(); b++) {
+    out << b + 1 << '\t' << blocks[b]->genes.size() << '\t' << blocks[b]->conds.size() << '\t';
+    writeIndices(out, blocks[b]->genes, x.rowNames);
+    out << '\t';
+    writeIndices(out, blocks[b]->conds, x.colNames);
+    out << '\n';
+    delete blocks[b];
+  }
+  cerr << "runibic: " << nr << " x " << nc << " matrix, " << blocks.size() << " biclusters from "
+       << stats[0].Seeds << " seeds\n";
+  cerr << "runibic: peak memory of the stages in MB: input " << megabytes(gPeakMemory.Input) << ", pairs " << megabytes(gPeakMemory.Pairs)
+       << (gPeakMemory.StreamPairs ? " (streamed)" : "") << ", cluster " << megabytes(gPeakMemory.Cluster)
+       << ", output " << megabytes(gPeakMemory.Output) << "\n";
+  cerr << "runibic: lcs of " << gPairStats.Pairs << " pairs (" << gPairStats.ShortPairs << " bit-parallel), busy seconds of the threads:";
+  for (size_t i = 0; i < gPairStats.ThreadBusy.size(); i++)
+    cerr << ' ' << round(gPairStats.ThreadBusy[i] * 100) / 100;
+  cerr << "\n";
+  return 0;
+}
@@ -0,0 +1,99 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+
+#include "BlockStream.h"
+
+using namespace std;
+
+static const char BLOCK_FILE_MAGIC[8] = {'R','U','N','I','B','I','C','\0'};
+
+bool BlockFileWriter::open(std::string const &path) {
+  close();
+  Failed = false;
+  File = fopen(path.c_str(), "wb");
+  if (File == NULL)
+    return false;
+  BlockFileHeader header;
+  memcpy(header.magic, BLOCK_FILE_MAGIC, sizeof(header.magic));
+  header.version = BLOCK_FILE_VERSION;
+  header.reserved = 0;
+  Failed = fwrite(&header, sizeof(header), 1, File) != 1 || fflush(File) != 0;
+  return !Failed;
+}
+
+void BlockFileWriter::emit(BicBlock const &block) {
+  if (File == NULL || Failed)
+    return;
+  int32_t sizes[3] = {static_cast<int32_t>(block.genes.size()), static_cast<int32_t>(block.conds.size()), block.score};
+  double pvalue = static_cast<double>(block.pvalue);
+  vector<int32_t> indices(block.genes.begin(), block.genes.end());
+  indices.insert(indices.end(), block.conds.begin(), block.conds.end());
+  Failed = fwrite(sizes, sizeof(int32_t), 3, File) != 3
+        || fwrite(&pvalue, sizeof(double), 1, File) != 1
+        || (!indices.empty() && fwrite(indices.data(), sizeof(int32_t), indices.size(), File) != indices.size())
+        || fflush(File) != 0;
+}
+
+/* false if the file could not be written completely */
+bool BlockFileWriter::close() {
+  if (File == NULL)
+    return !Failed;
+  Failed = (fclose(File) != 0) || Failed;
+  File = NULL;
+  return !Failed;
+}
+
+/* appends the blocks stored in the file to blocks, a last block which is still being written is skipped */
+bool readBlockFile(std::string const &path, std::vector<BicBlock> &blocks) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL)
+    return false;
+  BlockFileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1
+         && memcmp(header.magic, BLOCK_FILE_MAGIC, sizeof(header.magic)) == 0
+         && header.version == BLOCK_FILE_VERSION;
+  int32_t sizes[3];
+  double pvalue;
+  vector<int32_t> indices;
+  while (ok && fread(sizes, sizeof(int32_t), 3, f) == 3) {
+    if (sizes[0] < 0 || sizes[1] < 0 || fread(&pvalue, sizeof(double), 1, f) != 1)
+      break;
+    indices.resize(static_cast<size_t>(sizes[0]) + sizes[1]);
+    if (!indices.empty() && fread(indices.data(), sizeof(int32_t), indices.size(), f) != indices.size())
+      break;
+    BicBlock block = BicBlock();
+    block.genes.assign(indices.begin(), indices.begin() + sizes[0]);
+    block.conds.assign(indices.begin() + sizes[0], indices.end());
+    block.block_rows = sizes[0];
+    block.block_cols = sizes[1];
+    block.score = sizes[2];
+    block.pvalue = pvalue;
+    blocks.push_back(block);
+  }
+  fclose(f);
+  return ok;
+}
@@ -0,0 +1,60 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+
+#ifndef BLOCKSTREAM_H
+#define BLOCKSTREAM_H
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include "GlobalDefs.h"
+
+/* header of a binary file with biclusters appended as they are found,
+   every block is stored as int32 rows, columns and score, a float64 pvalue
+   and the int32 indices of its rows followed by the indices of its columns */
+struct BlockFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+static const uint32_t BLOCK_FILE_VERSION = 1;
+
+/* appends every emitted block to a file, which is flushed after each block
+   so it can be read while the clustering is still running */
+class BlockFileWriter : public BlockSink {
+public:
+  BlockFileWriter(): File(NULL), Failed(false) {};
+  ~BlockFileWriter() { close(); }
+
+  bool open(std::string const &path);
+  void emit(BicBlock const &block);
+  bool close();
+
+private:
+  FILE *File;
+  bool Failed;
+};
+
+bool readBlockFile(std::string const &path, std::vector<BicBlock> &blocks);
+#endif
@@ -21,7 +21,6 @@ SOFTWARE.
 ***/
 
 #include <iostream>
-#include <Rcpp.h>
 #include <cstdlib>
 #include <omp.h>
 #include <vector>
@@ -29,14 +28,18 @@ SOFTWARE.
 #include <algorithm>
 #include <utility>
 #include <iterator>
+#include <climits>
+#include <cmath>
+#include <unordered_map>
 #include "GlobalDefs.h"
+#include "LCSCache.h"
 #include "fib.h"
 #include "fibpriv.h"
 
 
 using namespace std;
-using namespace Rcpp;
 extern Params gParameters;
+extern PairStats gPairStats;
 
 int edge_cmpr(void *a, void *b)
 {
@@ -64,23 +67,23 @@ bool check_seed(int score, int geneOne, int geneTwo,  std::vector<BicBlock*> con
 
   for (auto ind = 0; ind < block_id; ind++) {
 
-    bool result1 = FALSE;
+    bool result1 = false;
     int i;
     for (i=0; i<vecBlk[ind]->genes.size(); i++){
       if (vecBlk[ind]->genes.at(i)==geneOne)
       {
-        result1 = TRUE; break;
+        result1 = true; break;
       }
     }
-    auto result2 = FALSE;
+    auto result2 = false;
     for (i=0; i<vecBlk[ind]->genes.size(); i++){
       if (vecBlk[ind]->genes.at(i)==geneTwo)
       {
-        result2 = TRUE; break;
+        result2 = true; break;
       }
     }
     if ( result1 && result2){
-      return FALSE;
+      return false;
     }
     if (result1 && b1 == -1) {
       b1 = ind;
@@ -90,7 +93,7 @@ bool check_seed(int score, int geneOne, int geneTwo,  std::vector<BicBlock*> con
     }
   }
   if ( (b1 == -1)||(b2 == -1) )
-    return TRUE;
+    return true;
   else {
     vector<int> profiles(rowNum,0);
     for (auto i = 0; i < vecBlk[b1]->block_rows; i++)
@@ -99,66 +102,166 @@ bool check_seed(int score, int geneOne, int geneTwo,  std::vector<BicBlock*> con
       profiles[vecBlk[b2]->genes.at(i)]++;
     for (auto i = 0; i < rowNum; i++)
       if (profiles[i] > 1)
-        return FALSE;
+        return false;
     b3 = max(vecBlk[b1]->block_cols, vecBlk[b2]->block_cols);
     if ( score < b3)
-      return FALSE;
+      return false;
     else 
-      return TRUE;
+      return true;
   }
-  return FALSE;
+  return false;
 }
 
 
-//lcsTags is vector<vector<int>>
-void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vector<int> &genes, std::vector<int> &scores, vector<bool> &candidates, const int cand_threshold, int *components, std::vector<long double> &pvalues, Params* params, std::vector<std::vector<int>> &lcsTags, std::vector<std::vector<int>> *inputData){
- 
-  int rowNum = gParameters.RowNumber;
-  int colNum = gParameters.ColNumber;
-  int cnt = 0, cnt_all=0, pid=0,row_all = rowNum;
-  float cnt_ave=0;
-  long double pvalue;
+/* lcs of the seed rows and of the first seed row with every other row
+   restricted to the columns of the seed lcs, these do not depend on Tolerance */
+template<typename T>
+void block_tags(int geneOne, int geneTwo, RowSet<T> &lcsTags, RowSet<T> const *inputData, Params* params, std::vector<ThreadScratch<T>> *scratch){
 
-  int max_cnt, max_i;
-  int t0,t1;
-
-  
-  t0=genes[0];
-  t1=genes[1];
+  int rowNum = params->RowNumber;
+  int t0 = geneOne, t1 = geneTwo;
   /*************************calculate the lcs*********************************/
   //PO: It seems to be the same as calling 
   //PO: backtrackLCS(g1,g2)
-  lcsTags.clear();
-  lcsTags.resize(rowNum);
-  
-  lcsTags[t1] = getGenesFullLCS((*inputData)[t0],(*inputData)[t1]);
-  set<int> colcand(lcsTags[t1].begin(), lcsTags[t1].end());
-  std::vector<int> g1Common;
+  std::vector<T> seedTag;
+  LcsWorkspace<T> seedWorkspace;
+  getGenesFullLCS((*inputData)[t0], (*inputData)[t1], seedTag, seedWorkspace);
+  // the first seed row restricted to the columns of the seed lcs is the seed lcs itself
+  LcsPattern<T> g1Common;
+  g1Common.assign(RowSpan<T>(seedTag));
   //lcsLength[t1]=getGenesFullLCS(g1,g2,lcsTags[t1],NULL,colNum); 
-  for (auto i = 0; i < (*inputData)[t0].size() ;i++){
-    auto res = colcand.find((*inputData)[t0][i]);
-    if(res!=colcand.end())
-      g1Common.push_back((*inputData)[t0][i]);
-  }
-  int max=omp_get_max_threads();
-  omp_set_num_threads(max);
-  
-  
-  std::vector<int> gJ;  
-  #pragma omp parallel for default(shared) private(gJ) 
-  for(auto j=0;j<rowNum;j++) {
-    if (j==t1 || j==t0)
-      continue;
-    for(auto i=0;i<(*inputData)[j].size();i++)
-    {
-      auto res2 = colcand.find((*inputData)[j][i]);
-      if(res2!=colcand.end())
-        gJ.push_back((*inputData)[j][i]);
+  parallelRows(lcsTags, rowNum, params->NumThreads(), [&](int j, std::vector<T> &out, LcsWorkspace<T> &workspace) {
+    if (j==t1) {
+      out.insert(out.end(), seedTag.begin(), seedTag.end());
+      return;
     }
-    lcsTags[j] = getGenesFullLCS(g1Common,gJ);
-    gJ.clear();
+    if (j==t0)
+      return;
+    // the row restricted to the columns of the seed lcs
+    g1Common.commonTags((*inputData)[j], out, workspace);
     //lcsLength[j]= getGenesFullLCS(g1,(*inputData)[j].data(),lcsTags[j],lcsTags[t1],colNum); 
+  }, scratch, "seed lcs");
+}
+
+template<typename T>
+std::shared_ptr<const RowSet<T>> SeedTagCache<T>::find(int geneOne, int geneTwo) {
+  std::shared_ptr<const RowSet<T>> tags;
+  #pragma omp critical(SeedTagCache)
+  {
+    auto it = Entries.find(std::make_pair(geneOne, geneTwo));
+    if (it != Entries.end()) {
+      tags = it->second;
+      Hits++;
+    }
+    else
+      Misses++;
+  }
+  return tags;
+}
+
+/* the oldest seeds are evicted when the cache exceeds MaxBytes */
+template<typename T>
+void SeedTagCache<T>::insert(int geneOne, int geneTwo, std::shared_ptr<const RowSet<T>> tags) {
+  size_t size = tags->bytes();
+  #pragma omp critical(SeedTagCache)
+  {
+    auto key = std::make_pair(geneOne, geneTwo);
+    if (size <= MaxBytes && Entries.find(key) == Entries.end()) {
+      while (Bytes + size > MaxBytes && !Order.empty()) {
+        auto oldest = Entries.find(Order.front());
+        Bytes -= oldest->second->bytes();
+        Entries.erase(oldest);
+        Order.pop_front();
+      }
+      Entries[key] = tags;
+      Order.push_back(key);
+      Bytes += size;
+    }
+  }
+}
+
+template<typename T>
+PairTagCache<T>::PairTagCache(size_t maxBytes): Shards(SHARDS), MaxBytes(maxBytes), FilterBytes(0) {
+  for (auto it = Shards.begin(); it != Shards.end(); it++) {
+    omp_init_lock(&it->Lock);
+    it->Bytes = 0;
+  }
+  omp_init_lock(&FilterLock);
+}
+
+template<typename T>
+PairTagCache<T>::~PairTagCache() {
+  for (auto it = Shards.begin(); it != Shards.end(); it++)
+    omp_destroy_lock(&it->Lock);
+  omp_destroy_lock(&FilterLock);
+}
+
+template<typename T>
+bool PairTagCache<T>::find(PairTagKey const &key, std::vector<T> &lcsTag) {
+  Shard &s = shard(key);
+  omp_set_lock(&s.Lock);
+  auto it = s.Entries.find(key);
+  bool found = it != s.Entries.end();
+  if (found)
+    lcsTag.insert(lcsTag.end(), it->second.begin(), it->second.end());
+  omp_unset_lock(&s.Lock);
+  return found;
+}
+
+template<typename T>
+void PairTagCache<T>::insert(PairTagKey const &key, RowSpan<T> tags) {
+  size_t size = entryBytes(tags.size()), shardBytes = MaxBytes / SHARDS;
+  if (size > shardBytes)
+    return;
+  Shard &s = shard(key);
+  omp_set_lock(&s.Lock);
+  if (s.Entries.find(key) == s.Entries.end()) {
+    while (s.Bytes + size > shardBytes && !s.Order.empty()) {
+      auto oldest = s.Entries.find(s.Order.front());
+      s.Bytes -= entryBytes(oldest->second.size());
+      s.Entries.erase(oldest);
+      s.Order.pop_front();
+    }
+    s.Entries[key].assign(tags.begin(), tags.end());
+    s.Order.push_back(key);
+    s.Bytes += size;
+  }
+  omp_unset_lock(&s.Lock);
+}
+
+template<typename T>
+uint64_t PairTagCache<T>::filterId(std::vector<char> const &columns) {
+  omp_set_lock(&FilterLock);
+  auto it = Filters.find(columns);
+  if (it == Filters.end()) {
+    it = Filters.insert(make_pair(columns, static_cast<uint64_t>(Filters.size() + 1))).first;
+    FilterBytes += columns.size() + sizeof(uint64_t) + 64;
   }
+  uint64_t id = it->second;
+  omp_unset_lock(&FilterLock);
+  return id;
+}
+
+template<typename T>
+size_t PairTagCache<T>::bytes() const {
+  size_t size = FilterBytes;
+  for (auto it = Shards.begin(); it != Shards.end(); it++)
+    size += it->Bytes;
+  return size;
+}
+
+//lcsTags is the RowSet computed by block_tags
+template<typename T>
+void block_init(int geneTwo, BicBlock *block, std::vector<int> &genes, std::vector<int> &scores, vector<bool> &candidates, const int cand_threshold, int *components, std::vector<long double> &pvalues, Params* params, RowSet<T> const &lcsTags){
+ 
+  int rowNum = params->RowNumber;
+  int cnt = 0, cnt_all=0, row_all = rowNum;
+  float cnt_ave=0;
+  long double pvalue = 0;
+
+  int max_cnt, max_i;
+  set<int> colcand(lcsTags[geneTwo].begin(), lcsTags[geneTwo].end());
+
   while (*components < rowNum) {
     max_cnt = -1;
     max_i = -1;
@@ -173,7 +276,7 @@ void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vecto
         continue;
       }
 
-      cnt= count_if(lcsTags[i].begin(), lcsTags[i].end(), [&](int k) { return colcand.find(k) != colcand.end();});
+      cnt= count_if(lcsTags[i].begin(), lcsTags[i].end(), [&](T k) { return colcand.find(k) != colcand.end();});
 
       cnt_all += cnt;
       if (cnt < cand_threshold)
@@ -187,22 +290,23 @@ void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vecto
 
     long double one = 1;
     long double poisson=one/exp(cnt_ave);
+    pvalue = 0;
     for (auto i=0;i<max_cnt+300;i++) {
       if (i>(max_cnt-1)) 
         pvalue=pvalue+poisson;
       else 
         poisson=poisson*cnt_ave/(i+1);
     }
-    if (gParameters.IsCond) {
-      if (max_cnt < gParameters.ColWidth || max_i < 0|| max_cnt < block->cond_low_bound) break;
+    if (params->IsCond) {
+      if (max_cnt < params->ColWidth || max_i < 0|| max_cnt < block->cond_low_bound) break;
     }
     else {
-      if (max_cnt < gParameters.ColWidth || max_i < 0){
+      if (max_cnt < params->ColWidth || max_i < 0){
         break;        
       }
     }
     int tempScore = 0;
-    if (gParameters.IsArea)
+    if (params->IsArea)
       tempScore = (*components)*max_cnt;
     else
       tempScore = min(*components, max_cnt);
@@ -212,7 +316,7 @@ void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vecto
       block->pvalue = pvalue;
     genes.push_back(max_i);
     scores.push_back(tempScore);
-    pvalues[pid++] = pvalue;
+    pvalues.push_back(pvalue);
 
     for (auto it = colcand.begin(); it != colcand.end();){
       auto res = find(lcsTags[max_i].begin(), lcsTags[max_i].end(), *it);
@@ -221,108 +325,273 @@ void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vecto
       else
         ++it;
     }
-    candidates[max_i] = FALSE;
+    candidates[max_i] = false;
   }
 }
 
-std::vector<int> getGenesFullLCS(std::vector<int> const &s1, std::vector<int> const &s2){
+/* minimal column statistics over colList after adding the columns of tag */
+template<typename T>
+static int min_column_stat(RowSpan<T> tag, std::vector<int> const &colList, std::vector<int> const &colsStat, std::vector<char> &mark) {
+  int low = INT_MAX;
+  for (auto it = tag.begin(); it != tag.end(); it++)
+    mark[*it] = 1;
+  for (auto it = colList.begin(); it != colList.end(); it++)
+    low = min(low, colsStat[*it] + mark[*it]);
+  for (auto it = tag.begin(); it != tag.end(); it++)
+    mark[*it] = 0;
+  return low;
+}
 
-  vector<int> maxRecord;/*record the max value of matrix*/
-  vector<int> lcsTag;
-  int maxvalue,rank;
-  
-  int **C,**B;
+/* admit candidate rows to the bicluster in index order
+   rows depend on each other only through colsStat and components, which both
+   grow when a row is accepted, so eligibility is evaluated in parallel against
+   a snapshot and a row is re-checked only if it failed on a stale snapshot */
+template<typename T>
+void admit_candidates(RowSet<T> const &tags, std::vector<int> const &colcand, std::vector<bool> &candidates, const int countThreshold, std::vector<int> &colsStat, std::vector<int> &vecGenes, int &components, const int nthreads, SeedArena<T> &arena) {
 
-  /*create matrix for lcs*/
-  C = new int*[s1.size()+1];
-  B = new int*[s1.size()+1];
-  
-  for(auto i=0;i<s1.size()+1;i++) {
-    C[i] = new int[s2.size()+1];
-    B[i] = new int[s2.size()+1];
+  int rowNum = candidates.size();
+  int colNum = colsStat.size();
+  std::vector<int> const &colList = colcand;
+  vector<char> &inColcand = arena.InColCand;
+  inColcand.assign(colNum, 0);
+  for (auto it = colList.begin(); it != colList.end(); it++)
+    inColcand[*it] = 1;
+
+  vector<char> &active = arena.Active;
+  active.assign(rowNum, 0);
+  for (auto ki = 0; ki < rowNum; ki++)
+    active[ki] = candidates[ki];
+  vector<int> &matched = arena.Matched;
+  vector<int> &minStat = arena.MinStat;
+  matched.assign(rowNum, 0);
+  minStat.assign(rowNum, INT_MAX);
+  vector<ThreadScratch<T>> &threads = arena.Threads;
+
+  #pragma omp parallel default(shared) num_threads(nthreads)
+  {
+    #pragma omp single
+    if (threads.size() < omp_get_num_threads())
+      threads.resize(omp_get_num_threads());
+    vector<char> &mark = threads[omp_get_thread_num()].Mark;
+    mark.assign(colNum, 0);
+    #pragma omp for schedule(dynamic, 64)
+    for (auto ki = 0; ki < rowNum; ki++) {
+      if (!active[ki])
+        continue;
+      // count number of occurances of candidates in results of lcs
+      matched[ki] = count_if(tags[ki].begin(), tags[ki].end(), [&](T k) { return inColcand[k] != 0; });
+      if (matched[ki] >= countThreshold)
+        minStat[ki] = min_column_stat(tags[ki], colList, colsStat, mark);
+    }
   }
+
+  vector<char> &mark = threads[0].Mark;
+  bool stale = false;
+  for (auto ki = 0; ki < rowNum; ki++) {
+    if (!active[ki] || matched[ki] < countThreshold)
+      continue;
+    //check if this candidate can be added
+    double lowBound = floor(components * 0.1)-1;
+    if (stale && minStat[ki] < lowBound)
+      minStat[ki] = min_column_stat(tags[ki], colList, colsStat, mark);
+    if (minStat[ki] < lowBound)
+      continue;
+    //add new gene
+    vecGenes.push_back(ki);
+    components++;
+    candidates[ki] = false;
+    //update column statistics
+    for (auto it = tags[ki].begin(); it != tags[ki].end(); it++)
+      colsStat[*it]++;
+    stale = true;
+  }
+}
+
+/* number of positions set in both bit masks */
+int countCommonBits(const uint64_t *a, const uint64_t *b, const int words) {
+  int cnt = 0;
+  for (auto w = 0; w < words; w++)
+    cnt += popcount64(a[w] & b[w]);
+  return cnt;
+}
+
+/* appends the columns of s1 which are on the last of the longest common subsequences to lcsTag */
+template<typename T>
+void getGenesFullLCS(RowSpan<T> s1, RowSpan<T> s2, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace){
+
+  typedef typename LcsCount<T>::type Count;
+  int maxvalue;
+  int lastMax = -1;/*the last column with the max value of matrix*/
+  const size_t width = s2.size()+1;
+
+  /*create matrix for lcs, row i starts at i*width*/
+  workspace.C.resize((s1.size()+1)*width);
+  workspace.B.resize((s1.size()+1)*width);
+  Count *C = workspace.C.data();
+  uint8_t *B = workspace.B.data();
   
   /************initial the edge***************/
   for(auto i=0; i<s1.size()+1; i++) {
-    C[i][0] = 0;
-    B[i][0] = 0;
+    C[i*width] = 0;
+    B[i*width] = 0;
   }
   for(auto j=0; j<s2.size()+1; j++) {
-    C[0][j] = 0;
-    B[0][j] = 0; 
+    C[j] = 0;
+    B[j] = 0; 
   }
   /************DP*****************************/
-    for(auto i=1; i<s1.size()+1; i++) {
+  for(auto i=1; i<s1.size()+1; i++) {
+    Count *c = C + i*width, *cUp = c - width;
+    uint8_t *b = B + i*width;
     for(auto j=1; j<s2.size()+1; j++) {
-        if(s1[i-1] == s2[j-1]) {
-          C[i][j] = C[i-1][j-1] + 1;
-          B[i][j] = 1;
-        }
-        else if(C[i-1][j] >= C[i][j-1]) {
-          C[i][j] = C[i-1][j];
-          B[i][j] = 2;
-        }
-        else {
-          C[i][j] = C[i][j-1];
-          B[i][j] = 3;
-        }
+      if(s1[i-1] == s2[j-1]) {
+        c[j] = cUp[j-1] + 1;
+        b[j] = 1;
+      }
+      else if(cUp[j] >= c[j-1]) {
+        c[j] = cUp[j];
+        b[j] = 2;
+      }
+      else {
+        c[j] = c[j-1];
+        b[j] = 3;
       }
     }
-  maxvalue = C[s1.size()][s2.size()];
+  }
+  maxvalue = C[s1.size()*width + s2.size()];
   
   for (auto j=1;j<s2.size()+1;j++) {
-    if (C[s1.size()][j] == maxvalue)
-      maxRecord.push_back(j);
+    if (C[s1.size()*width + j] == maxvalue)
+      lastMax = j;
   }
   /*find all the columns of all LCSs*/
-  if(maxRecord.size() > 0) {
-
-    for (auto i=maxRecord.size()-1;i>=0;i--) {
-      TrackBack(C,B, s1.size()+1,maxRecord[i]+1);      
-      break;
-    }
+  if(lastMax >= 0) {
+    TrackBack(C, B, width, s1.size()+1, lastMax+1);
     for (auto i=1;i<s1.size()+1;i++) {
       for (auto j=1;j<s2.size()+1;j++) {
-        if (C[i][j] == -1 && B[i][j]==1) {
+        if (C[i*width + j] == -1 && B[i*width + j]==1) {
             lcsTag.push_back(s1[i-1]);
         }
       } //end for j
     } // end for i  
-     // Print the lcs
-     //cout << "LCS of " << X << " and " << Y << " is " << lcs;
-    }
-  for(auto i=0;i<s1.size()+1;i++) {
-    delete[] C[i];
-    delete[] B[i];
   }
-  delete[] C;
-  delete[] B;
+}
+
+
+
+template<typename T>
+void LcsPattern<T>::assign(RowSpan<T> pattern) {
+  Pattern.assign(pattern.begin(), pattern.end());
+  int maxColumn = -1;
+  for (auto it = Pattern.begin(); it != Pattern.end(); it++)
+    maxColumn = max(maxColumn, static_cast<int>(*it));
+  Position.assign(maxColumn + 1, -1);
+  for (size_t i = 0; i < Pattern.size(); i++)
+    Position[Pattern[i]] = i;
+  Words = (Pattern.size() + 63) / 64;
+}
 
-  return lcsTag;
+/* number of zero bits among the first i bits of v */
+static inline int zerosBelow(const uint64_t *v, const int i) {
+  int ones = 0, w = 0;
+  for (; (w + 1) * 64 <= i; w++)
+    ones += popcount64(v[w]);
+  if (i % 64 != 0)
+    ones += popcount64(v[w] & ((static_cast<uint64_t>(1) << (i % 64)) - 1));
+  return i - ones;
 }
 
+/* bit i-1 of column j of the table is zero when the lcs of the first i and i-1 columns of the pattern
+   with the first j columns of s2 differ by one (Hyyro), a match moves that step down to its position;
+   all columns of the table are kept and the path of getGenesFullLCS is traced back on them */
+template<typename T>
+void LcsPattern<T>::tags(RowSpan<T> s2, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace) const {
+  const int n = Pattern.size(), m = s2.size();
+  if (n == 0 || m == 0)
+    return;
+  std::vector<uint64_t> &bits = workspace.Bits;
+  bits.resize(static_cast<size_t>(m + 1) * Words);
+  uint64_t *V = bits.data();
+  for (auto w = 0; w < Words; w++)
+    V[w] = (w + 1) * 64 <= n ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << (n % 64)) - 1;
+  for (auto j = 1; j <= m; j++) {
+    const uint64_t *prev = V + static_cast<size_t>(j - 1) * Words;
+    uint64_t *cur = V + static_cast<size_t>(j) * Words;
+    std::copy(prev, prev + Words, cur);
+    int p = contains(s2[j-1]) ? Position[s2[j-1]] : -1;
+    if (p < 0 || !((cur[p / 64] >> (p % 64)) & 1))
+      continue;
+    cur[p / 64] &= ~(static_cast<uint64_t>(1) << (p % 64));
+    // the carry of V + U stops at the first zero above p, bits from n onwards are dropped
+    int w = p / 64;
+    uint64_t zeros = ~cur[w] & ((~static_cast<uint64_t>(0) << (p % 64)) << 1);
+    while (zeros == 0 && ++w < Words)
+      zeros = ~cur[w];
+    if (w < Words) {
+      int q = w * 64 + lowestBit64(zeros);
+      if (q < n)
+        cur[w] |= static_cast<uint64_t>(1) << (q % 64);
+    }
+  }
 
+  // the path of TrackBack from the last cell, up is preferred over left on ties
+  size_t first = lcsTag.size();
+  int i = n, j = m;
+  int value = zerosBelow(V + static_cast<size_t>(m) * Words, n);
+  while (i > 0 && j > 0) {
+    if (contains(s2[j-1]) && Position[s2[j-1]] == i - 1) {
+      lcsTag.push_back(Pattern[i-1]);
+      i--;
+      j--;
+      value--;
+      continue;
+    }
+    const uint64_t *col = V + static_cast<size_t>(j) * Words;
+    int up = value - !((col[(i - 1) / 64] >> ((i - 1) % 64)) & 1);
+    int left = zerosBelow(col - Words, i);
+    if (up >= left) {
+      i--;
+      value = up;
+    }
+    else {
+      j--;
+      value = left;
+    }
+  }
+  reverse(lcsTag.begin() + first, lcsTag.end());
+}
+
+template<typename T>
+void LcsPattern<T>::commonTags(RowSpan<T> row, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace) const {
+  std::vector<T> &common = workspace.Row;
+  common.clear();
+  for (auto it = row.begin(); it != row.end(); it++)
+    if (contains(*it))
+      common.push_back(*it);
+  tags(RowSpan<T>(common), lcsTag, workspace);
+}
 
 /*track back the matrix*/
-void TrackBack(int** pc,int** pb,int nrow,int ncolumn) {
-  int ntemp;
-  if(nrow == 0 || ncolumn == 0)
-    return;
-  ntemp = pb[nrow-1][ncolumn-1];
-  pc[nrow-1][ncolumn-1] = -1;
+template<typename C>
+void TrackBack(C* pc,uint8_t* pb,int width,int nrow,int ncolumn) {
+  while (nrow > 0 && ncolumn > 0) {
+    int ntemp = pb[(nrow-1)*width + ncolumn-1];
+    pc[(nrow-1)*width + ncolumn-1] = -1;
          
-  switch(ntemp) {
-    case 1:
-      TrackBack(pc, pb, nrow-1, ncolumn-1);
-      break;
-    case 2:
-      TrackBack(pc, pb, nrow-1, ncolumn);
-      break;
-    case 3:
-      TrackBack(pc, pb, nrow, ncolumn-1);
-      break;
-    default:
-      break;
+    switch(ntemp) {
+      case 1:
+        nrow--;
+        ncolumn--;
+        break;
+      case 2:
+        nrow--;
+        break;
+      case 3:
+        ncolumn--;
+        break;
+      default:
+        return;
+    }
   }
 }
 
@@ -331,108 +600,567 @@ short* getRowData(int index) {
   return NULL;
 }
 
-void internalPairwiseLCS(std::vector<int> &x, std::vector<int> &y, std::vector<std::vector<int>> &c){
+/* length of the lcs of x and y, only two rows of the table are kept */
+template<typename T>
+int pairwiseLCSLength(RowSpan<T> x, RowSpan<T> y, LcsWorkspace<T> &workspace){
 
-  for (auto i=0; i<x.size()+1; i++) {
-    c[i].resize(y.size()+1);
-    c[i][0]=0;
+  typedef typename LcsCount<T>::type Count;
+  workspace.C.assign(2*(y.size()+1), 0);
+  Count *prev = workspace.C.data(), *cur = prev + y.size()+1;
+  for(auto i=1; i<x.size()+1; i++) {
+    for(auto j=1; j<y.size()+1; j++) {
+      if(x[i-1] == y[j-1]) {
+        cur[j] = prev[j-1] + 1;
+      }
+      else {
+        cur[j] = std::max(cur[j-1],prev[j]);
+      }
+    }
+    std::swap(prev, cur);
   }
+  return prev[y.size()];
+}
+/* length of the lcs of a row x of at most SHORT_ROW_LENGTH columns and a row y,
+   bit-parallel in one word as in LcsPattern, every column occurs at most once in a row */
+template<typename T>
+int shortLCSLength(RowSpan<T> x, RowSpan<T> y, LcsWorkspace<T> &workspace){
+  std::vector<int8_t> &position = workspace.Position;
+  for (size_t p = 0; p < x.size(); p++) {
+    if (x[p] >= position.size())
+      position.resize(x[p] + 1, -1);
+    position[x[p]] = p;
+  }
+  uint64_t v = ~0ULL;
+  for (auto it = y.begin(); it != y.end(); it++) {
+    if (*it < position.size() && position[*it] >= 0) {
+      uint64_t u = v & (1ULL << position[*it]);
+      v = (v + u) | (v - u);
+    }
+  }
+  for (auto it = x.begin(); it != x.end(); it++)
+    position[*it] = -1;
+  uint64_t mask = x.size() == 64 ? ~0ULL : (1ULL << x.size()) - 1;
+  return popcount64(~v & mask);
+}
+
+/* estimated work of the lcs of rows of lengths a and b */
+static uint64_t pairCells(size_t a, size_t b){
+  if (std::min(a, b) <= SHORT_ROW_LENGTH)
+    return a + b + 1;
+  return static_cast<uint64_t>(a) * b;
+}
 
-  for (auto j=0; j<y.size()+1; j++) {
-    c[0][j]=0;
+/* calculate lcslen of every pair with geneA and geneB already filled,
+   pairs with a copy of duplicates are left to DuplicateRows::fill;
+   threads take chunks of consecutive pairs with about the same estimated work, with Quantile < 0.5
+   the lengths of rows vary and chunks of as many pairs would leave the longest ones on the last thread */
+template<typename T>
+void scorePairs(RowSet<T> const &inputMatrix, std::vector<triple> &triplets, DuplicateRows<T> *duplicates){
+  const size_t k = triplets.size();
+  const int nthreads = gParameters.NumThreads();
+  uint64_t total = 0;
+  for (size_t p = 0; p < k; p++)
+    if (duplicates == NULL || !duplicates->copied(triplets[p]))
+      total += pairCells(inputMatrix[triplets[p].geneA].size(), inputMatrix[triplets[p].geneB].size());
+  uint64_t target = std::max(total / (16 * nthreads), PAIR_CHUNK_CELLS), cells = 0;
+  vector<size_t> bounds(1, 0);
+  for (size_t p = 0; p < k; p++) {
+    if (duplicates == NULL || !duplicates->copied(triplets[p]))
+      cells += pairCells(inputMatrix[triplets[p].geneA].size(), inputMatrix[triplets[p].geneB].size());
+    if (cells >= target) {
+      bounds.push_back(p + 1);
+      cells = 0;
+    }
   }
-  for(auto i=1; i<x.size()+1; i++) {
-      for(auto j=1; j<y.size()+1; j++) {
-        if(x[i-1] == y[j-1]) {
-          c[i][j] = c[i-1][j-1] + 1;
+  if (bounds.back() < k)
+    bounds.push_back(k);
+
+  const ptrdiff_t chunks = bounds.size() - 1;
+  if (gPairStats.ThreadBusy.size() < static_cast<size_t>(nthreads))
+    gPairStats.ThreadBusy.resize(nthreads, 0);
+#pragma omp parallel shared(triplets) num_threads(nthreads)
+  {
+    LcsWorkspace<T> workspace;
+    long pairs = 0, shortPairs = 0;
+    uint64_t dpCells = 0;
+    double busy = 0;
+#pragma omp for schedule(dynamic)
+    for(ptrdiff_t c = 0; c < chunks; c++){
+      TraceSpan span("lcs of pairs", "pairs", bounds[c+1] - bounds[c]);
+      double start = omp_get_wtime();
+      for (size_t p = bounds[c]; p < bounds[c+1]; p++) {
+        if (duplicates != NULL && duplicates->copied(triplets[p]))
+          continue;
+        RowSpan<T> x = inputMatrix[triplets[p].geneA], y = inputMatrix[triplets[p].geneB];
+        if (y.size() < x.size())
+          std::swap(x, y);
+        if (x.size() <= SHORT_ROW_LENGTH) {
+          triplets[p].lcslen = shortLCSLength(x, y, workspace);
+          shortPairs++;
         }
         else {
-          c[i][j] = std::max(c[i][j-1],c[i-1][j]);
+          triplets[p].lcslen = pairwiseLCSLength(x, y, workspace);
+          dpCells += static_cast<uint64_t>(x.size()) * y.size();
         }
+        pairs++;
+      }
+      busy += omp_get_wtime() - start;
+    }
+#pragma omp critical
+    {
+      gPairStats.Pairs += pairs;
+      gPairStats.ShortPairs += shortPairs;
+      gPairStats.Cells += dpCells;
+      gPairStats.ThreadBusy[omp_get_thread_num()] += busy;
     }
   }
 }
-void internalCalulateLCS(std::vector<std::vector<int>> &inputMatrix, std::vector<triple> &out, bool useFib){
 
+template<typename T>
+DuplicateRows<T>::DuplicateRows(RowSet<T> const &rows, size_t maxBytes)
+  : Rep(rows.size()), Slot(rows.size(), -1), BlockStart(rows.size()), Width(0), Copies(0) {
+  int rowNum = rows.size();
   int PART = 4;
-  int step = inputMatrix.size()/PART;
-  int size = (PART-1)*(step*(step-1)/2);
-  int rest = step+(inputMatrix.size()%PART);
-  size+= rest*(rest-1)/2;
-  vector<triple> triplets(size);
-  struct fibheap *heap = NULL;
-  if(useFib){
-    heap = fh_makeheap();
-    fh_setcmp(heap, edge_cmpr);
+  int step = rowNum/PART;
+  Width = rowNum - (PART-1)*step;
+
+  // classes of equal sequences within every block, candidates are found by the hash of the sequence
+  vector<int> copies(rowNum, 0);
+  for (auto p = 0; p < PART; p++) {
+    int begini = p*step, endi = p == PART-1 ? rowNum : (p+1)*step;
+    unordered_map<uint64_t, vector<int>> classes;
+    for (auto i = begini; i < endi; i++) {
+      RowSpan<T> row = rows[i];
+      BlockStart[i] = begini;
+      Rep[i] = i;
+      vector<int> &reps = classes[hashBytes(row.begin(), sizeof(T) * row.size(), row.size())];
+      for (auto it = reps.begin(); it != reps.end() && Rep[i] == i; it++)
+        if (rows[*it].size() == row.size() && equal(row.begin(), row.end(), rows[*it].begin()))
+          Rep[i] = *it;
+      if (Rep[i] == i)
+        reps.push_back(i);
+      else
+        copies[Rep[i]]++;
+    }
   }
- 
- 
-// TODO: change into parallel version
-// there should be 1-level for loop across all combinations of pairs of rows
-//  #pragma omp parallel for private(a,b,i,j,res) schedule(dynamic)
-//  for ( auto k=0; k<size; k++ ) {
-//    auto i = k/discreteInput.nrow(); auto j=k%discreteInput.nrow(); 
-  //triple __cur_min = {0, 0, po->COL_WIDTH};
-  triple __cur_min;
-  __cur_min.lcslen = gParameters.ColWidth;
-  triple *_cur_min = &__cur_min;
-  triple **cur_min = &_cur_min;;
-  int k=0;
-  for(auto p = 0; p < PART; p++){
-    auto endi = (p+1)*step;
-    if(p == PART-1)
-      endi = inputMatrix.size();
-    for (auto i=p*step; i<endi; i++) {
-      for (auto j=i+1; j<endi; j++) {
-        triplets[k].geneA = i;
-        triplets[k].geneB = j;
-        k++;
+
+  // the classes with most copies get a row of Lcs, copies of the other classes are computed as usual
+  vector<int> reps;
+  for (auto i = 0; i < rowNum; i++)
+    if (copies[i] > 0)
+      reps.push_back(i);
+  stable_sort(reps.begin(), reps.end(), [&](int x, int y) { return copies[x] > copies[y]; });
+  size_t slots = std::min(reps.size(), maxBytes / (sizeof(int) * std::max(Width, static_cast<size_t>(1))));
+  for (size_t r = 0; r < slots; r++)
+    Slot[reps[r]] = r;
+  for (auto i = 0; i < rowNum; i++) {
+    if (Slot[Rep[i]] < 0)
+      Rep[i] = i;
+    else if (Rep[i] != i)
+      Copies++;
+  }
+  if (Copies > 0)
+    Lcs.assign(slots * Width, 0);
+}
+
+/* bytes of DuplicateRows for rowNum rows at most */
+size_t duplicateRowsBytes(const int rowNum) {
+  size_t width = rowNum - 3*(rowNum/4);
+  return 3 * sizeof(int) * rowNum + std::min(DUPLICATE_ROWS_BYTES, sizeof(int) * (rowNum/2) * width);
+}
+
+/* lcs of the pairs with a copy from the lcs of the representatives, the chunks of pairs
+   are passed in the order of enumeratePairs after scorePairs has computed the other pairs */
+template<typename T>
+void DuplicateRows<T>::fill(RowSet<T> const &rows, std::vector<triple> &triplets) {
+  for (auto it = triplets.begin(); it != triplets.end(); it++) {
+    int a = it->geneA, b = it->geneB;
+    int repA = Rep[a], repB = Rep[b];
+    if (repA == a && repB == b) {
+      if (Slot[a] >= 0)
+        lcs(a, b) = it->lcslen;
+      if (Slot[b] >= 0)
+        lcs(b, a) = it->lcslen;
+    }
+    else if (repA == repB)
+      it->lcslen = rows[a].size();
+    else
+      it->lcslen = Slot[repA] >= 0 ? lcs(repA, repB) : lcs(repB, repA);
+  }
+}
+
+/* size of a heap element with the header of its allocation */
+static const size_t HEAP_ELEMENT_BYTES = (sizeof(struct fibheap_el) + sizeof(size_t) + 15) / 16 * 16;
+
+PairSelection::PairSelection(bool useFib, std::vector<triple> &out)
+  : UseFib(useFib), Out(out), First(out.size()), Heap(NULL), CurMin(&MinValue), PeakBytes(0) {
+  MinValue.lcslen = gParameters.ColWidth;
+  if (UseFib) {
+    Heap = fh_makeheap();
+    fh_setcmp(Heap, edge_cmpr);
+  }
+}
+
+PairSelection::~PairSelection() {
+  if (Heap != NULL) {
+    while (Heap->fh_n > 0)
+      fh_extractmin(Heap);
+    free(Heap);
+  }
+}
+
+/* bytes of the buffers of the selection holding kept pairs, besides out */
+size_t PairSelection::keptBytes(size_t kept, bool useFib, bool copy) {
+  if (useFib)
+    return kept * (HEAP_ELEMENT_BYTES + (copy ? sizeof(triple) : 0));
+  // the buffer of stable_sort
+  return (kept + 1) / 2 * sizeof(triple);
+}
+
+void PairSelection::add(std::vector<triple> &triplets, bool copy) {
+  if (!UseFib) {
+    Out.insert(Out.end(), triplets.begin(), triplets.end());
+    return;
+  }
+  size_t k = triplets.size();
+  for (size_t p = 0; p < k; p++) {
+    if (triplets[p].lcslen < CurMin->lcslen)
+      continue;
+    if (Heap->fh_n < HEAP_SIZE) {
+      triple *kept = &triplets[p];
+      if (copy) {
+        Kept.push_back(triplets[p]);
+        kept = &Kept.back();
       }
+      fh_insert(Heap, kept);
+      /* once the heap is full only pairs longer than its least one are kept */
+      if (Heap->fh_n == HEAP_SIZE)
+        CurMin = static_cast<triple *>(fh_min(Heap));
+    }
+    else if (edge_cmpr(CurMin, &triplets[p]) < 0) {
+      /* Remove least value and renew, a copied pair takes the place of the removed one */
+      triple *removed = static_cast<triple *>(fh_extractmin(Heap));
+      if (copy)
+        *removed = triplets[p];
+      fh_insert(Heap, copy ? removed : &triplets[p]);
+      /* Keep a memory of the current min */
+      CurMin = static_cast<triple *>(fh_min(Heap));
     }
   }
-#pragma omp parallel for shared(triplets) schedule(dynamic)
-  for(auto p = 0; p < k; p++){
-    vector<int> a = inputMatrix[triplets[p].geneA];
-    vector<int> b = inputMatrix[triplets[p].geneB];
-    vector< vector<int> > res(a.size()+1);
-    internalPairwiseLCS(a,b,res);
-    triplets[p].lcslen= res[a.size()][b.size()];
+  PeakBytes = std::max(PeakBytes, keptBytes(Heap->fh_n, true, copy));
+}
+
+/* append the selected pairs to out in the order in which cluster consumes seeds */
+void PairSelection::finish() {
+  if (!UseFib) {
+    PeakBytes = std::max(PeakBytes, keptBytes(Out.size() - First, false, false));
+    stable_sort(Out.begin() + First, Out.end(), &is_higher);
+    return;
+  }
+  for (int i = Heap->fh_n - 1; i >= 0; i--) {
+    triple *res = static_cast<triple *>(fh_extractmin(Heap));
+    Out.push_back(*res);
   }
-  if(useFib){
-      for(auto p = 0; p < k; p++){
-        if (triplets[p].lcslen < ((*cur_min)->lcslen)){
+  reverse(Out.begin() + First, Out.end());
+  free(Heap);
+  Heap = NULL;
+  Kept.clear();
+}
+
+/* append scored pairs to out in the order in which cluster consumes seeds */
+void orderPairs(std::vector<triple> &triplets, std::vector<triple> &out, bool useFib){
+  PairSelection selection(useFib, out);
+  selection.add(triplets, false);
+  selection.finish();
+}
+
+/* number of pairs compared by internalCalulateLCS, rows are paired only within each of PART blocks */
+size_t countPairs(const int rowNum){
+  int PART = 4;
+  size_t step = rowNum/PART;
+  size_t size = (PART-1)*(step*(step-1)/2);
+  size_t rest = step+(rowNum%PART);
+  size+= rest*(rest-1)/2;
+  return size;
+}
+
+/* number of pairs of a block of n rows that come before its row r */
+static size_t pairsBefore(const size_t n, const size_t r){
+  return r*(n-1) - r*(r-1)/2;
+}
+
+/* append the pairs with positions [first, last) in the order used by internalCalulateLCS,
+   the first row of the range is found by bisection so chunks of any position cost the same */
+void enumeratePairs(const int rowNum, const size_t first, const size_t last, std::vector<triple> &triplets){
+  int PART = 4;
+  int step = rowNum/PART;
+  size_t k = 0;
+  for(auto p = 0; p < PART && k < last; p++){
+    int begini = p*step, endi = (p+1)*step;
+    if(p == PART-1)
+      endi = rowNum;
+    size_t n = endi-begini, blockPairs = n*(n-1)/2;
+    if (k + blockPairs <= first) {
+      k += blockPairs;
+      continue;
+    }
+    size_t lo = 0, hi = n-1;
+    if (first > k) {
+      // the last row r of the block with pairsBefore(n, r) <= first-k
+      while (lo + 1 < hi) {
+        size_t mid = lo + (hi-lo)/2;
+        if (pairsBefore(n, mid) <= first-k)
+          lo = mid;
+        else
+          hi = mid;
+      }
+    }
+    k += pairsBefore(n, lo);
+    for (auto i=begini+static_cast<int>(lo); i<endi && k < last; i++) {
+      for (auto j=i+1; j<endi; j++, k++) {
+        if (k < first)
           continue;
-        } 
-        if (heap->fh_n < HEAP_SIZE) 
-        {
-          fh_insert(heap, (void *)&triplets[p]);
-        }
-      else
-      {
-        if (edge_cmpr(cur_min, &triplets[p]) < 0)
-        {
-          /* Remove least value and renew */
-          fh_extractmin(heap);
-          fh_insert(heap, (void *)&triplets[p]);
-          /* Keep a memory of the current min */
-          *cur_min = (triple *)fh_min(heap);
+        if (k >= last)
+          break;
+        triple t;
+        t.geneA = i;
+        t.geneB = j;
+        triplets.push_back(t);
+      }
+    }
+  }
+}
+
+/* block of row i in the pairing used by internalCalulateLCS */
+static int pairBlock(const int rowNum, const int i){
+  int PART = 4;
+  int step = rowNum/PART;
+  if (step == 0)
+    return PART-1;
+  return min(i/step, PART-1);
+}
+
+static uint64_t splitmix64(uint64_t &state){
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/* candidate pairs of rows proposed by banded hashing of sketches of the column order:
+   each band records, for bandWidth random pairs of columns, which of the two comes first in the row
+   (or that one of them is missing) and rows with the same record in any band are paired;
+   only pairs compared by internalCalulateLCS are proposed and they are appended in its order */
+template<typename T>
+void screenPairs(RowSet<T> const &inputMatrix, const int colNumber, const int bands, const int bandWidth, const int seed, std::vector<triple> &triplets){
+  int rowNum = inputMatrix.size();
+  if (rowNum < 2 || colNumber < 2 || bands < 1 || bandWidth < 1)
+    return;
+  int sampled = bands*bandWidth;
+  vector<int> colA(sampled), colB(sampled);
+  uint64_t state = static_cast<uint64_t>(seed);
+  for (auto s = 0; s < sampled; s++) {
+    colA[s] = splitmix64(state) % colNumber;
+    colB[s] = (colA[s] + 1 + splitmix64(state) % (colNumber - 1)) % colNumber;
+  }
+
+  /* band keys of every row, 0 marks a band where all sampled columns are missing */
+  vector<uint64_t> keys(static_cast<size_t>(rowNum)*bands);
+#pragma omp parallel num_threads(gParameters.NumThreads())
+  {
+    vector<int> position(colNumber);
+#pragma omp for schedule(static)
+    for (auto i = 0; i < rowNum; i++) {
+      RowSpan<T> row = inputMatrix[i];
+      fill(position.begin(), position.end(), -1);
+      for (auto p = 0; p < row.size(); p++)
+        position[row[p]] = p;
+      for (auto b = 0; b < bands; b++) {
+        uint64_t key = 0xCBF29CE484222325ULL;
+        bool present = false;
+        for (auto s = b*bandWidth; s < (b+1)*bandWidth; s++) {
+          int pa = position[colA[s]];
+          int pb = position[colB[s]];
+          int order = 2;
+          if (pa >= 0 && pb >= 0) {
+            order = pa < pb;
+            present = true;
+          }
+          key = (key ^ order) * 0x100000001B3ULL;
         }
+        keys[static_cast<size_t>(i)*bands+b] = present ? (key | 1) : 0;
       }
     }
-    for(int i=heap->fh_n-1; i>=0; i--){
-      triple *res= static_cast<triple *>(fh_extractmin(heap));
-      out.push_back(*res);
+  }
+
+  /* the pairs of each band are merged into those of the previous bands, so that at most
+     the pairs of internalCalulateLCS are held however many bands propose them */
+  vector<uint64_t> pairs, band, merged;
+  vector<pair<uint64_t,int>> bucket(rowNum);
+  for (auto b = 0; b < bands; b++) {
+    band.clear();
+    for (auto i = 0; i < rowNum; i++)
+      bucket[i] = make_pair(keys[static_cast<size_t>(i)*bands+b], i);
+    sort(bucket.begin(), bucket.end());
+    for (auto first = 0; first < rowNum; ) {
+      auto last = first+1;
+      while (last < rowNum && bucket[last].first == bucket[first].first)
+        last++;
+      if (bucket[first].first != 0) {
+        for (auto x = first; x < last; x++) {
+          for (auto y = x+1; y < last; y++) {
+            int i = bucket[x].second;
+            int j = bucket[y].second;
+            if (pairBlock(rowNum, i) == pairBlock(rowNum, j))
+              band.push_back((static_cast<uint64_t>(i) << 32) | static_cast<uint64_t>(j));
+          }
+        }
+      }
+      first = last;
     }
-    reverse(out.begin(), out.end());
-    free(heap);
-    heap = NULL;
+    sort(band.begin(), band.end());
+    merged.clear();
+    set_union(pairs.begin(), pairs.end(), band.begin(), band.end(), back_inserter(merged));
+    pairs.swap(merged);
+  }
+  triplets.reserve(triplets.size()+pairs.size());
+  for (auto p : pairs) {
+    triple t;
+    t.geneA = static_cast<int>(p >> 32);
+    t.geneB = static_cast<int>(p & 0xFFFFFFFFULL);
+    triplets.push_back(t);
   }
-  else  {
-    stable_sort( triplets.begin(), triplets.end(), &is_higher);
-    out.insert(out.end(), triplets.begin(), triplets.end());
+}
+
+/* pairs compared by internalCalulateLCS with the longest lcs on a random subset of colFraction of the columns,
+   budget of them are appended in the order of enumeratePairs, ties are broken by that order */
+template<typename T>
+void subsamplePairs(RowSet<T> const &inputMatrix, const int colNumber, const double colFraction, const size_t budget, const int seed, std::vector<triple> &triplets){
+  int rowNum = inputMatrix.size();
+  if (rowNum < 2 || colNumber < 1 || budget == 0)
+    return;
+  int sampled = max(1, min(colNumber, static_cast<int>(ceil(colFraction*colNumber))));
+  vector<int> columns(colNumber);
+  for (auto c = 0; c < colNumber; c++)
+    columns[c] = c;
+  vector<char> keep(colNumber, 0);
+  uint64_t state = static_cast<uint64_t>(seed);
+  for (auto c = 0; c < sampled; c++) {
+    swap(columns[c], columns[c + splitmix64(state) % (colNumber - c)]);
+    keep[columns[c]] = 1;
+  }
+
+  RowSet<T> subsampled;
+  for (auto i = 0; i < rowNum; i++) {
+    for (auto c : inputMatrix[i])
+      if (keep[c])
+        subsampled.Values.push_back(c);
+    subsampled.Offsets.push_back(subsampled.Values.size());
+  }
+
+  size_t size = countPairs(rowNum);
+  vector<triple> approx;
+  approx.reserve(size);
+  enumeratePairs(rowNum, 0, size, approx);
+  scorePairs(subsampled, approx);
+  vector<size_t> order(size);
+  for (size_t p = 0; p < size; p++)
+    order[p] = p;
+  if (budget < size) {
+    nth_element(order.begin(), order.begin()+budget, order.end(), [&](size_t x, size_t y) {
+      return approx[x].lcslen > approx[y].lcslen || (approx[x].lcslen == approx[y].lcslen && x < y);
+    });
+    order.resize(budget);
+    sort(order.begin(), order.end());
+  }
+  triplets.reserve(triplets.size()+order.size());
+  for (auto p : order)
+    triplets.push_back(approx[p]);
+}
+
+/* score the pairs of internalCalulateLCS and append them to out ordered for cluster,
+   pairs are scored chunk at a time, 0 for all at once, and only the selected ones of each chunk are kept,
+   pairs with a row equal to an earlier one of its block are copied by DuplicateRows;
+   returns the peak size in bytes of the buffers besides out */
+template<typename T>
+size_t internalCalulateLCS(RowSet<T> const &inputMatrix, std::vector<triple> &out, bool useFib, size_t chunk){
+
+  size_t size = countPairs(inputMatrix.size());
+  chunk = chunk == 0 ? size : std::min(size, chunk);
+  bool streamed = chunk < size;
+  DuplicateRows<T> duplicates(inputMatrix, DUPLICATE_ROWS_BYTES);
+  DuplicateRows<T> *copies = duplicates.empty() ? NULL : &duplicates;
+  vector<triple> triplets;
+  triplets.reserve(chunk);
+  PairSelection selection(useFib, out);
+  for (size_t first = 0; first < size; first += chunk) {
+    triplets.clear();
+    enumeratePairs(inputMatrix.size(), first, std::min(first + chunk, size), triplets);
+    scorePairs(inputMatrix, triplets, copies);
+    if (copies != NULL)
+      copies->fill(inputMatrix, triplets);
+    selection.add(triplets, streamed);
   }
-  triplets.clear();
-  vector<triple>().swap(triplets);
+  selection.finish();
+  return sizeof(triple) * triplets.capacity() + selection.peakBytes() + duplicates.bytes();
+}
+
+/* score the pairs with positions [first, last) of internalCalulateLCS in chunks of PAIR_CHUNK
+   and append the ones with lcs of at least minLength to out, in the same order */
+template<typename T>
+void internalPairRange(RowSet<T> const &inputMatrix, const size_t first, const size_t last, const int minLength, std::vector<triple> &out){
+  vector<triple> triplets;
+  triplets.reserve(std::min(last - first, PAIR_CHUNK));
+  for (size_t begin = first; begin < last; begin += PAIR_CHUNK) {
+    triplets.clear();
+    enumeratePairs(inputMatrix.size(), begin, std::min(begin + PAIR_CHUNK, last), triplets);
+    scorePairs(inputMatrix, triplets);
+    for (auto it = triplets.begin(); it != triplets.end(); it++)
+      if (it->lcslen >= minLength)
+        out.push_back(*it);
+  }
+}
+
+/* the pairs of internalCalulateLCS of all rows appended to out as it orders them, the lcs of pairs of rows
+   before firstNew is taken from previous where it has them, the blocks of PART move with the number of rows
+   and previous may miss pairs dropped by the heap, so all other pairs are scored */
+template<typename T>
+void internalIncrementalLCS(RowSet<T> const &inputMatrix, const int firstNew, std::vector<triple> const &previous,
+  std::vector<triple> &out, bool useFib){
+  vector<pair<uint64_t,int>> known;
+  known.reserve(previous.size());
+  for (auto it = previous.begin(); it != previous.end(); it++)
+    if (it->geneA >= 0 && it->geneB >= 0 && it->geneA < firstNew && it->geneB < firstNew)
+      known.push_back(make_pair((static_cast<uint64_t>(min(it->geneA, it->geneB)) << 32) | static_cast<uint64_t>(max(it->geneA, it->geneB)), it->lcslen));
+  sort(known.begin(), known.end());
+
+  size_t size = countPairs(inputMatrix.size());
+  size_t chunk = std::min(size, PAIR_CHUNK);
+  vector<triple> triplets, missing;
+  vector<size_t> position;
+  triplets.reserve(chunk);
+  PairSelection selection(useFib, out);
+  for (size_t first = 0; first < size; first += chunk) {
+    triplets.clear();
+    missing.clear();
+    position.clear();
+    enumeratePairs(inputMatrix.size(), first, std::min(first + chunk, size), triplets);
+    for (size_t p = 0; p < triplets.size(); p++) {
+      uint64_t key = (static_cast<uint64_t>(triplets[p].geneA) << 32) | static_cast<uint64_t>(triplets[p].geneB);
+      auto found = lower_bound(known.begin(), known.end(), make_pair(key, INT_MIN));
+      if (triplets[p].geneB < firstNew && found != known.end() && found->first == key)
+        triplets[p].lcslen = found->second;
+      else {
+        missing.push_back(triplets[p]);
+        position.push_back(p);
+      }
+    }
+    scorePairs(inputMatrix, missing);
+    for (size_t p = 0; p < missing.size(); p++)
+      triplets[position[p]].lcslen = missing[p].lcslen;
+    selection.add(triplets, chunk < size);
+  }
+  selection.finish();
 }
 
 bool blockComp(BicBlock*lhs, BicBlock* rhs) {
@@ -440,15 +1168,23 @@ bool blockComp(BicBlock*lhs, BicBlock* rhs) {
   return lhs->score > rhs->score;
 }
 
-double calculateQuantile(Rcpp::NumericVector vecData, int size, double qParam)
-{
-  double delta = (size-1)*qParam;
-  if(delta < 0)
-    delta = 0;
-  int i = floor(delta);
-  delta=delta-i;
-  if(i < size - 1)
-    return (1-delta)*vecData(i) + (delta)*vecData(i+1);
-  else 
-    return (1-delta)*vecData(i);
-}
+/* instantiations for the index types selected by indexBytes */
+#define INSTANTIATE_INDEX_TYPE(T) \
+  template class SeedTagCache<T>; \
+  template class LcsPattern<T>; \
+  template class PairTagCache<T>; \
+  template void block_tags<T>(int, int, RowSet<T> &, RowSet<T> const *, Params *, std::vector<ThreadScratch<T>> *); \
+  template void block_init<T>(int, BicBlock *, std::vector<int> &, std::vector<int> &, std::vector<bool> &, const int, int *, std::vector<long double> &, Params *, RowSet<T> const &); \
+  template void admit_candidates<T>(RowSet<T> const &, std::vector<int> const &, std::vector<bool> &, const int, std::vector<int> &, std::vector<int> &, int &, const int, SeedArena<T> &); \
+  template void getGenesFullLCS<T>(RowSpan<T>, RowSpan<T>, std::vector<T> &, LcsWorkspace<T> &); \
+  template class DuplicateRows<T>; \
+  template void scorePairs<T>(RowSet<T> const &, std::vector<triple> &, DuplicateRows<T> *); \
+  template void screenPairs<T>(RowSet<T> const &, const int, const int, const int, const int, std::vector<triple> &); \
+  template void subsamplePairs<T>(RowSet<T> const &, const int, const double, const size_t, const int, std::vector<triple> &); \
+  template size_t internalCalulateLCS<T>(RowSet<T> const &, std::vector<triple> &, bool, const size_t); \
+  template void internalPairRange<T>(RowSet<T> const &, const size_t, const size_t, const int, std::vector<triple> &); \
+  template void internalIncrementalLCS<T>(RowSet<T> const &, const int, std::vector<triple> const &, std::vector<triple> &, bool);
+
+INSTANTIATE_INDEX_TYPE(uint8_t)
+INSTANTIATE_INDEX_TYPE(uint16_t)
+INSTANTIATE_INDEX_TYPE(int)
@@ -25,8 +25,18 @@ SOFTWARE.
 #define GLOBALDEFS_H
 
 #include <vector>
+#include <string>
 #include <algorithm>
-#include <Rcpp.h>
+#include <set>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <cmath>
+#include <cstddef>
+#include <omp.h>
+#include "Trace.h"
 
 
 class Params{
@@ -46,7 +56,9 @@ public:
   , Shuffle(0)
   , Divided(0)
   , ColWidth(0)
-  , UseLegacy(false){};
+  , UseLegacy(false)
+  , Threads(0)
+  , MaxMemory(0){};
 
   int RowNumber;
   int ColNumber;
@@ -63,7 +75,13 @@ public:
   int Divided;
   int ColWidth;
   bool UseLegacy;
+  int Threads; // number of OpenMP threads, 0 keeps the current OpenMP setting
+  std::string CacheDir; // directory with cached results of calculateLCS, empty disables the cache
+  size_t MaxMemory; // bytes available to the buffers of a stage, 0 for no limit
 
+  int NumThreads() const {
+    return Threads > 0 ? Threads : omp_get_max_threads();
+  }
 
   void InitOptions(int rowNum, int colNum){
     RowNumber = rowNum;
@@ -108,6 +126,14 @@ typedef struct BicBlock {
   long double pvalue;
 } BicBlock;
 
+/* receives each block accepted by the seed loop of internalCluster as soon as it is found,
+   before the blocks are sorted and the overlapping ones are filtered out */
+class BlockSink {
+public:
+  virtual ~BlockSink() {};
+  virtual void emit(BicBlock const &block) = 0;
+};
+
 struct triple {
   int geneA;
   int geneB;
@@ -117,18 +143,443 @@ struct triple {
   , lcslen(0){};
 };
 static const int HEAP_SIZE = 20000000;
+static const size_t PAIR_CHUNK = static_cast<size_t>(1) << 20; // pairs scored at once when they are streamed
+static const size_t PAIR_CHUNK_MIN = static_cast<size_t>(1) << 14; // least pairs scored at once to fit in MaxMemory
+static const size_t SWEEP_TAG_CACHE_BYTES = static_cast<size_t>(512) << 20;
+static const size_t PAIR_TAG_CACHE_BYTES = static_cast<size_t>(64) << 20;
+static const size_t PAIR_TAG_MIN_WORK = 1024; // words of the lcs kernel below which PairTagCache is slower
+static const size_t DUPLICATE_ROWS_BYTES = static_cast<size_t>(64) << 20;
+static const size_t SHORT_ROW_LENGTH = 64; // rows up to one word long are compared by shortLCSLength
+static const uint64_t PAIR_CHUNK_CELLS = 1 << 16; // least work handed to a thread at once by scorePairs
+
+/* number of set bits in a 64-bit word */
+inline int popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* index of the lowest set bit of a nonzero 64-bit word */
+inline int lowestBit64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  return popcount64((x & (~x + 1)) - 1);
+#endif
+}
+
+/* column indices are stored in the narrowest of uint8_t, uint16_t and int
+   which holds every column of the matrix */
+inline int indexBytes(int colNumber) {
+  if (colNumber <= 256)
+    return 1;
+  if (colNumber <= 65536)
+    return 2;
+  return 4;
+}
+
+/* type of the LCS tables for index type T, holds lengths up to ncol and the -1 mark of TrackBack */
+template<typename T> struct LcsCount { typedef int type; };
+template<> struct LcsCount<uint8_t> { typedef int16_t type; };
+
+/* read-only view of a row of a RowSet or of a vector */
+template<typename T>
+struct RowSpan {
+  const T *ptr;
+  size_t len;
+  RowSpan(): ptr(NULL), len(0) {};
+  RowSpan(const T *p, size_t n): ptr(p), len(n) {};
+  RowSpan(std::vector<T> const &v): ptr(v.data()), len(v.size()) {};
+
+  const T *begin() const { return ptr; }
+  const T *end() const { return ptr + len; }
+  size_t size() const { return len; }
+  const T &operator[](size_t i) const { return ptr[i]; }
+};
+
+/* rows of different lengths stored contiguously (CSR),
+   row i takes Values[Offsets[i]] to Values[Offsets[i+1]-1] */
+template<typename T>
+class RowSet {
+public:
+  RowSet(): Offsets(1, 0) {};
+
+  size_t size() const { return Offsets.size() - 1; }
+  RowSpan<T> operator[](size_t i) const { return RowSpan<T>(Values.data() + Offsets[i], Offsets[i+1] - Offsets[i]); }
+  size_t bytes() const { return sizeof(T) * Values.capacity() + sizeof(size_t) * Offsets.capacity(); }
+  void clear() {
+    Values.clear();
+    Offsets.assign(1, 0);
+  }
+  void push_back(RowSpan<T> row) {
+    Values.insert(Values.end(), row.begin(), row.end());
+    Offsets.push_back(Values.size());
+  }
+
+  std::vector<T> Values;
+  std::vector<size_t> Offsets;
+};
+
+/* matrix stored elsewhere, column-major as R matrices or row-major as RowMajorMatrix */
+template<typename V>
+struct MatrixView {
+  V *Data;
+  int NRow;
+  int NCol;
+  size_t RowStride;
+  size_t ColStride;
+  MatrixView(V *data, int nrow, int ncol, bool rowMajor = false): Data(data), NRow(nrow), NCol(ncol),
+    RowStride(rowMajor ? ncol : 1), ColStride(rowMajor ? 1 : nrow) {};
+
+  int nrow() const { return NRow; }
+  int ncol() const { return NCol; }
+  bool rowMajor() const { return ColStride == 1; }
+  V &operator()(int i, int j) const { return Data[i * RowStride + j * ColStride]; }
+};
+
+/* buffers reused by the LCS kernels of one thread */
+template<typename T>
+struct LcsWorkspace {
+  std::vector<typename LcsCount<T>::type> C;
+  std::vector<uint8_t> B;
+  std::vector<T> Row;
+  std::vector<uint64_t> Bits;
+  std::vector<int8_t> Position; // positions of the columns of a short row, -1 for the other columns
+};
+
+/* one sequence preprocessed for computing getGenesFullLCS against many others,
+   the table of its columns replaces the matching and the lcs is computed bit-parallel,
+   one bit per position of the pattern, which relies on every column occurring at most once */
+template<typename T>
+class LcsPattern {
+public:
+  LcsPattern(): Words(0) {};
+
+  void assign(RowSpan<T> pattern);
+  bool contains(T column) const { return column < Position.size() && Position[column] >= 0; }
+  size_t size() const { return Pattern.size(); }
+  size_t bytes() const { return sizeof(T) * Pattern.capacity() + sizeof(int) * Position.capacity(); }
+  // appends the same columns as getGenesFullLCS(pattern, s2)
+  void tags(RowSpan<T> s2, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace) const;
+  // as tags for the subsequence of row made of the columns of the pattern
+  void commonTags(RowSpan<T> row, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace) const;
+
+private:
+  std::vector<T> Pattern;
+  std::vector<int> Position; // position of every column in the pattern or -1
+  int Words;
+};
+
+/* buffers of one thread kept between parallel loops */
+template<typename T>
+struct ThreadScratch {
+  std::vector<T> Local;
+  LcsWorkspace<T> Workspace;
+  std::vector<char> Mark;
+
+  size_t bytes() const {
+    return sizeof(T) * (Local.capacity() + Workspace.Row.capacity()) + Workspace.B.capacity() + Mark.capacity()
+      + sizeof(typename LcsCount<T>::type) * Workspace.C.capacity() + sizeof(uint64_t) * Workspace.Bits.capacity() + Workspace.Position.capacity();
+  }
+};
+
+/* fills rows [0, rowNum) of rows in parallel, fill(i, out, workspace) appends row i to out;
+   every thread gets a contiguous range of rows and its output is copied in place once,
+   so the buffers of rows keep their capacity when it is reused.
+   The buffers of the threads are taken from scratch, or are temporary if it is NULL,
+   the rows of every thread are traced as a span named traceName */
+template<typename T, typename F>
+void parallelRows(RowSet<T> &rows, const int rowNum, const int nthreads, F fill, std::vector<ThreadScratch<T>> *scratch = NULL,
+  const char *traceName = NULL) {
+  rows.Offsets.assign(rowNum + 1, 0);
+  std::vector<size_t> threadBase;
+  std::vector<ThreadScratch<T>> ownScratch;
+  std::vector<ThreadScratch<T>> &threads = scratch != NULL ? *scratch : ownScratch;
+  #pragma omp parallel num_threads(nthreads)
+  {
+    int tid = omp_get_thread_num(), nth = omp_get_num_threads();
+    #pragma omp single
+    {
+      threadBase.assign(nth + 1, 0);
+      if (threads.size() < nth)
+        threads.resize(nth);
+    }
+    int first = static_cast<long>(rowNum) * tid / nth, last = static_cast<long>(rowNum) * (tid + 1) / nth;
+    std::vector<T> &local = threads[tid].Local;
+    local.clear();
+    {
+      TraceSpan span(traceName, "rows", last - first);
+      for (auto i = first; i < last; i++) {
+        fill(i, local, threads[tid].Workspace);
+        rows.Offsets[i+1] = local.size();
+      }
+    }
+    threadBase[tid+1] = local.size();
+    #pragma omp barrier
+    #pragma omp single
+    {
+      for (auto t = 0; t < nth; t++)
+        threadBase[t+1] += threadBase[t];
+      rows.Values.resize(threadBase[nth]);
+    }
+    for (auto i = first; i < last; i++)
+      rows.Offsets[i+1] += threadBase[tid];
+    std::copy(local.begin(), local.end(), rows.Values.begin() + threadBase[tid]);
+  }
+}
+
+template<typename T>
+size_t vectorBytes(std::vector<T> const &v) {
+  return sizeof(T) * v.capacity();
+}
+
+/* scratch memory of the seed loop of one clustering run, reset after every seed;
+   the buffers keep their capacity, so a seed allocates only if it needs more than the previous ones */
+template<typename T>
+class SeedArena {
+public:
+  SeedArena(): PeakBytes(0) {};
+
+  size_t bytes() const {
+    size_t size = vectorBytes(Genes) + vectorBytes(Scores) + vectorBytes(ColsStat) + vectorBytes(ColCand)
+      + Candidates.capacity() / 8 + vectorBytes(Pvalues) + vectorBytes(RevColumns) + vectorBytes(LowCommon)
+      + vectorBytes(G1Common) + Tags.bytes() + TempTags.bytes() + ReveTags.bytes()
+      + vectorBytes(InColCand) + vectorBytes(Active) + vectorBytes(Matched) + vectorBytes(MinStat)
+      + Pattern.bytes();
+    for (auto it = Threads.begin(); it != Threads.end(); it++)
+      size += it->bytes();
+    return size;
+  }
+  void reset() {
+    PeakBytes = std::max(PeakBytes, bytes());
+    Genes.clear();
+    Scores.clear();
+    Pvalues.clear();
+    ColCand.clear();
+    G1Common.clear();
+  }
+
+  // per seed buffers of internalCluster
+  std::vector<int> Genes;
+  std::vector<int> Scores;
+  std::vector<int> ColsStat;
+  std::vector<int> ColCand;
+  std::vector<bool> Candidates;
+  std::vector<long double> Pvalues;
+  std::vector<char> RevColumns;
+  std::vector<char> LowCommon;
+  std::vector<T> G1Common;
+  RowSet<T> Tags;
+  RowSet<T> TempTags;
+  RowSet<T> ReveTags;
+  LcsPattern<T> Pattern;
+  // buffers of admit_candidates
+  std::vector<char> InColCand;
+  std::vector<char> Active;
+  std::vector<int> Matched;
+  std::vector<int> MinStat;
+  std::vector<ThreadScratch<T>> Threads;
+
+  size_t PeakBytes;
+};
+
+/* statistics of a clustering run, returned in the info element of the result */
+struct ClusterStats {
+  ClusterStats(): Seeds(0), ScratchBytes(0), TagHits(0), TagMisses(0) {};
+  long Seeds; // number of expanded seeds
+  size_t ScratchBytes; // peak size of the scratch buffers of the seed loop
+  long TagHits; // lookups of the seed loop answered by PairTagCache
+  long TagMisses;
+};
+
+/* work of scorePairs since the last pair stage started, reported by pairStats */
+struct PairStats {
+  PairStats(): Pairs(0), ShortPairs(0), Cells(0) {};
+  long Pairs; // pairs whose lcs was computed
+  long ShortPairs; // pairs computed by shortLCSLength
+  uint64_t Cells; // cells of the dynamic programming of the other pairs
+  std::vector<double> ThreadBusy; // seconds every thread spent computing lcs
+};
+
+/* bounded cache of block_tags results keyed by the seed rows,
+   shared by the settings of a parameter sweep */
+template<typename T>
+class SeedTagCache {
+public:
+  explicit SeedTagCache(size_t maxBytes): MaxBytes(maxBytes), Bytes(0), Hits(0), Misses(0) {};
+
+  std::shared_ptr<const RowSet<T>> find(int geneOne, int geneTwo);
+  void insert(int geneOne, int geneTwo, std::shared_ptr<const RowSet<T>> tags);
+
+  size_t MaxBytes;
+  size_t Bytes;
+  long Hits;
+  long Misses;
+private:
+  std::map<std::pair<int,int>, std::shared_ptr<const RowSet<T>>> Entries;
+  std::deque<std::pair<int,int>> Order;
+};
+
+/* pair of rows whose tags are cached by PairTagCache, Filter identifies the columns
+   to which both rows were restricted and is 0 for whole rows */
+struct PairTagKey {
+  int RowA;
+  int RowB;
+  uint64_t Filter; // 0 for whole rows, otherwise the filterId of the columns to which both rows are restricted
+  bool operator==(PairTagKey const &other) const {
+    return RowA == other.RowA && RowB == other.RowB && Filter == other.Filter;
+  }
+};
+
+struct PairTagKeyHash {
+  size_t operator()(PairTagKey const &key) const {
+    uint64_t h = key.Filter ^ (static_cast<uint64_t>(static_cast<uint32_t>(key.RowA)) << 32 | static_cast<uint32_t>(key.RowB));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    return h ^ (h >> 33);
+  }
+};
+
+/* bounded cache of the getGenesFullLCS tags of pairs of rows, shared by the threads of the seed loop
+   and by the settings of a parameter sweep; the entries are split into shards with their own locks
+   and the oldest entries of a shard are evicted when it exceeds its part of MaxBytes */
+template<typename T>
+class PairTagCache {
+public:
+  explicit PairTagCache(size_t maxBytes);
+  ~PairTagCache();
+
+  // appends the cached tags of key to lcsTag, false if they are not cached
+  bool find(PairTagKey const &key, std::vector<T> &lcsTag);
+  void insert(PairTagKey const &key, RowSpan<T> tags);
+  // id of a filter of columns, equal filters get the same id and different ones never share it
+  uint64_t filterId(std::vector<char> const &columns);
+  size_t bytes() const;
+
+private:
+  PairTagCache(PairTagCache const &);
+  PairTagCache &operator=(PairTagCache const &);
+
+  struct Shard {
+    omp_lock_t Lock;
+    std::unordered_map<PairTagKey, std::vector<T>, PairTagKeyHash> Entries;
+    std::deque<PairTagKey> Order;
+    size_t Bytes;
+  };
+  static const int SHARDS = 64;
+  Shard &shard(PairTagKey const &key) { return Shards[PairTagKeyHash()(key) % SHARDS]; }
+  static size_t entryBytes(size_t length) { return sizeof(T) * length + sizeof(PairTagKey) + 64; }
+
+  std::vector<Shard> Shards;
+  size_t MaxBytes;
+  omp_lock_t FilterLock;
+  std::map<std::vector<char>, uint64_t> Filters; // kept for the whole sweep, their ids identify entries
+  size_t FilterBytes;
+};
+
+struct fibheap;
+
+/* selects the scored pairs used as seeds and orders them as cluster consumes seeds,
+   the pairs are appended to out by finish and can be added in several chunks;
+   with copy the kept pairs are copied, so that the chunk can be reused */
+class PairSelection {
+public:
+  PairSelection(bool useFib, std::vector<triple> &out);
+  ~PairSelection();
+
+  void add(std::vector<triple> &triplets, bool copy);
+  void finish();
+  size_t peakBytes() const { return PeakBytes; }
+  static size_t keptBytes(size_t kept, bool useFib, bool copy);
+
+private:
+  PairSelection(PairSelection const &);
+  PairSelection &operator=(PairSelection const &);
+
+  bool UseFib;
+  std::vector<triple> &Out;
+  size_t First;
+  struct fibheap *Heap;
+  triple MinValue;
+  triple *CurMin;
+  std::deque<triple> Kept; // copies of the pairs in the heap
+  size_t PeakBytes;
+};
+
+/* rows of a block of internalCalulateLCS with the same sequence as an earlier row of the block;
+   the lcs of such a copy with any row equals the lcs of the first row of its class (the representative),
+   so pairs with a copy are not computed but taken from the lcs of the representatives, which come earlier
+   in the order of pairs; only the classes with most copies whose lcs fit in maxBytes are collapsed */
+template<typename T>
+class DuplicateRows {
+public:
+  DuplicateRows(RowSet<T> const &rows, size_t maxBytes);
+
+  bool empty() const { return Copies == 0; }
+  bool copied(triple const &t) const { return Rep[t.geneA] != t.geneA || Rep[t.geneB] != t.geneB; }
+  void fill(RowSet<T> const &rows, std::vector<triple> &triplets);
+  int copies() const { return Copies; }
+  size_t bytes() const { return sizeof(int) * (Rep.capacity() + Slot.capacity() + Lcs.capacity()); }
+
+private:
+  int &lcs(int rep, int row) { return Lcs[static_cast<size_t>(Slot[rep]) * Width + (row - BlockStart[row])]; }
+
+  std::vector<int> Rep;        // representative of every row
+  std::vector<int> Slot;       // row of Lcs of a representative with copies, -1 for the other rows
+  std::vector<int> BlockStart; // first row of the block of every row
+  std::vector<int> Lcs;        // lcs of each representative with copies with every row of its block
+  size_t Width;
+  int Copies;
+};
 
 int edge_cmpr(void *a, void *b);
-double calculateQuantile(Rcpp::NumericVector vecData, int size, double qParam);
+
+/* quantile qParam of the first size values of vecData sorted in ascending order,
+   vecData is a vector or another container read by position */
+template<typename V>
+double calculateQuantile(V const &vecData, int size, double qParam)
+{
+  double delta = (size-1)*qParam;
+  if(delta < 0)
+    delta = 0;
+  int i = floor(delta);
+  delta=delta-i;
+  if(i < size - 1)
+    return (1-delta)*vecData[i] + (delta)*vecData[i+1];
+  else 
+    return (1-delta)*vecData[i];
+}
+
 bool check_seed(int score, int geneOne, int geneTwo,  std::vector<BicBlock*> const &vecBlk, const int block_id, int rowNum);
-void block_init(int score, int geneOne, int geneTwo, BicBlock *block, std::vector<int> &genes, std::vector<int> &scores, std::vector<bool> &candidates, const int cand_threshold, int *components, std::vector<long double> &pvalues, Params* params, std::vector<std::vector<int>> &lcsTags, std::vector<std::vector<int>> *inputData);
-std::vector<int> getGenesFullLCS(std::vector<int> const &s1, std::vector<int> const &s2);
-void TrackBack(int** pc,int** pb,int nrow,int ncolumn);
+template<typename T> void block_tags(int geneOne, int geneTwo, RowSet<T> &lcsTags, RowSet<T> const *inputData, Params* params, std::vector<ThreadScratch<T>> *scratch);
+template<typename T> void block_init(int geneTwo, BicBlock *block, std::vector<int> &genes, std::vector<int> &scores, std::vector<bool> &candidates, const int cand_threshold, int *components, std::vector<long double> &pvalues, Params* params, RowSet<T> const &lcsTags);
+template<typename T> void admit_candidates(RowSet<T> const &tags, std::vector<int> const &colcand, std::vector<bool> &candidates, const int countThreshold, std::vector<int> &colsStat, std::vector<int> &vecGenes, int &components, const int nthreads, SeedArena<T> &arena);
+int countCommonBits(const uint64_t *a, const uint64_t *b, const int words);
+template<typename T> void getGenesFullLCS(RowSpan<T> s1, RowSpan<T> s2, std::vector<T> &lcsTag, LcsWorkspace<T> &workspace);
+template<typename C> void TrackBack(C* pc,uint8_t* pb,int width,int nrow,int ncolumn);
 short* getRowData(int index);
 bool blockComp(BicBlock* lhs, BicBlock* rhs);
-void internalPairwiseLCS(std::vector<int> &x, std::vector<int> &y, std::vector<std::vector<int> > &c);
-void internalCalulateLCS(std::vector<std::vector<int>> &inputMatrix, std::vector<triple> &out, bool useFib);
-Rcpp::List fromBlocks(BicBlock ** blocks, const int numBlocks, const int nr, const int nc);
-Rcpp::IntegerVector backtrackLCS(Rcpp::IntegerVector x, Rcpp::IntegerVector y);
+template<typename T> int pairwiseLCSLength(RowSpan<T> x, RowSpan<T> y, LcsWorkspace<T> &workspace);
+template<typename T> int shortLCSLength(RowSpan<T> x, RowSpan<T> y, LcsWorkspace<T> &workspace);
+template<typename T> void scorePairs(RowSet<T> const &inputMatrix, std::vector<triple> &triplets, DuplicateRows<T> *duplicates = NULL);
+void orderPairs(std::vector<triple> &triplets, std::vector<triple> &out, bool useFib);
+size_t countPairs(const int rowNum);
+size_t duplicateRowsBytes(const int rowNum);
+void enumeratePairs(const int rowNum, const size_t first, const size_t last, std::vector<triple> &triplets);
+template<typename T> void screenPairs(RowSet<T> const &inputMatrix, const int colNumber, const int bands, const int bandWidth, const int seed, std::vector<triple> &triplets);
+template<typename T> void subsamplePairs(RowSet<T> const &inputMatrix, const int colNumber, const double colFraction, const size_t budget, const int seed, std::vector<triple> &triplets);
+template<typename T> size_t internalCalulateLCS(RowSet<T> const &inputMatrix, std::vector<triple> &out, bool useFib, const size_t chunk);
+template<typename T> void internalPairRange(RowSet<T> const &inputMatrix, const size_t first, const size_t last, const int minLength, std::vector<triple> &out);
+template<typename T> void internalIncrementalLCS(RowSet<T> const &inputMatrix, const int firstNew, std::vector<triple> const &previous,
+  std::vector<triple> &out, bool useFib);
+template<typename T> void rowSequences(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, RowSet<T> &discreteInputData);
+void nonzeroMasks(MatrixView<const int> discreteInputValues, const int rowNumber, const int colNumber, std::vector<uint64_t> &nonzeroMask);
+template<typename T> void internalCluster(Params *params, RowSet<T> const &discreteInputData, std::vector<uint64_t> const &nonzeroMask, std::vector<triple> const &seeds,
+  const int rowNumber, const int colNumber, std::vector<BicBlock*> &output, SeedTagCache<T> *tagCache, PairTagCache<T> *pairCache, ClusterStats *stats, BlockSink *sink);
 #endif
 
@@ -0,0 +1,210 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <process.h>
+#endif
+#include "LCSCache.h"
+
+using namespace std;
+
+static const char PAIR_FILE_MAGIC[8] = {'R','U','N','I','L','C','S','\0'};
+
+/* 64-bit FNV-1a hash */
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+  const unsigned char *p = static_cast<const unsigned char *>(data);
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* the key covers the discrete matrix and every setting which changes the result of internalCalulateLCS */
+uint64_t lcsCacheKey(MatrixView<const int> values, Params const &params, bool useFib) {
+  uint64_t h = 14695981039346656037ULL;
+  int32_t settings[6] = {values.nrow(), values.ncol(), params.Divided, params.ColWidth, 4 /* PART */, useFib ? 1 : 0};
+  h = hashBytes(settings, sizeof(settings), h);
+  h = hashBytes(&params.Quantile, sizeof(params.Quantile), h);
+  h = hashBytes(&PAIR_FILE_VERSION, sizeof(PAIR_FILE_VERSION), h);
+  if (!values.rowMajor())
+    return hashBytes(values.Data, sizeof(int) * static_cast<size_t>(values.nrow()) * values.ncol(), h);
+  // the values are hashed column by column, so the key does not depend on the layout
+  vector<int> column(values.nrow());
+  for (auto j = 0; j < values.ncol(); j++) {
+    for (auto i = 0; i < values.nrow(); i++)
+      column[i] = values(i, j);
+    h = hashBytes(column.data(), sizeof(int) * column.size(), h);
+  }
+  return h;
+}
+
+/* a shard file is valid only for the same input, settings and split of pairs */
+uint64_t lcsShardKey(uint64_t key, int shard, int nShards) {
+  int32_t split[2] = {shard, nShards};
+  return hashBytes(split, sizeof(split), key);
+}
+
+std::string lcsCachePath(std::string const &dir, uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "lcs-%016llx.bin", static_cast<unsigned long long>(key));
+  if (dir.empty() || dir[dir.size()-1] == '/')
+    return dir + name;
+  return dir + "/" + name;
+}
+
+/* creates a temporary file next to path under a name no other run uses, the name holds the process id
+   and a counter of its threads, names left by other runs are skipped */
+static FILE *createTemporary(std::string const &path, std::string &tmpPath) {
+  static std::atomic<unsigned> counter(0);
+  for (auto attempt = 0; attempt < 100; attempt++) {
+    char suffix[48];
+#ifndef _WIN32
+    snprintf(suffix, sizeof(suffix), ".tmp.%ld.%u", static_cast<long>(getpid()), counter++);
+    tmpPath = path + suffix;
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd >= 0) {
+      FILE *f = fdopen(fd, "wb");
+      if (f == NULL) {
+        close(fd);
+        remove(tmpPath.c_str());
+      }
+      return f;
+    }
+    if (errno != EEXIST)
+      return NULL;
+#else
+    snprintf(suffix, sizeof(suffix), ".tmp.%ld.%u", static_cast<long>(_getpid()), counter++);
+    tmpPath = path + suffix;
+    FILE *f = fopen(tmpPath.c_str(), "rb");
+    if (f == NULL)
+      return fopen(tmpPath.c_str(), "wb");
+    fclose(f);
+#endif
+  }
+  return NULL;
+}
+
+/* the file is written under a temporary name of its own and renamed, so concurrent runs never see a partial file
+   and each of them replaces the file with a complete one */
+bool writePairFile(std::string const &path, uint64_t key, std::vector<triple> const &pairs) {
+  PairFileHeader header;
+  memcpy(header.magic, PAIR_FILE_MAGIC, sizeof(header.magic));
+  header.version = PAIR_FILE_VERSION;
+  header.reserved = 0;
+  header.key = key;
+  header.count = pairs.size();
+
+  string tmpPath;
+  FILE *f = createTemporary(path, tmpPath);
+  if (f == NULL)
+    return false;
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  vector<int32_t> column(pairs.size());
+  for (auto c = 0; c < 3 && ok; c++) {
+    for (size_t i = 0; i < pairs.size(); i++)
+      column[i] = c == 0 ? pairs[i].geneA : (c == 1 ? pairs[i].geneB : pairs[i].lcslen);
+    ok = column.empty() || fwrite(column.data(), sizeof(int32_t), column.size(), f) == column.size();
+  }
+  ok = (fclose(f) == 0) && ok;
+  bool renamed = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+  if (!renamed)
+    remove(tmpPath.c_str());
+#ifdef _WIN32
+  // rename does not replace an existing file, which another run has written completely
+  if (ok && !renamed) {
+    FILE *existing = fopen(path.c_str(), "rb");
+    if (existing != NULL) {
+      fclose(existing);
+      renamed = true;
+    }
+  }
+#endif
+  return renamed;
+}
+
+static bool fillPairs(const char *data, size_t size, uint64_t key, std::vector<triple> &pairs) {
+  if (size < sizeof(PairFileHeader))
+    return false;
+  PairFileHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, PAIR_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != PAIR_FILE_VERSION || header.key != key)
+    return false;
+  if (size != sizeof(PairFileHeader) + 3 * sizeof(int32_t) * header.count)
+    return false;
+  const int32_t *geneA = reinterpret_cast<const int32_t *>(data + sizeof(PairFileHeader));
+  const int32_t *geneB = geneA + header.count;
+  const int32_t *lcslen = geneB + header.count;
+  size_t first = pairs.size();
+  pairs.resize(first + header.count);
+  for (size_t i = 0; i < header.count; i++) {
+    pairs[first+i].geneA = geneA[i];
+    pairs[first+i].geneB = geneB[i];
+    pairs[first+i].lcslen = lcslen[i];
+  }
+  return true;
+}
+
+/* appends the pairs stored in the file to pairs, the file is memory mapped where available */
+bool readPairFile(std::string const &path, uint64_t key, std::vector<triple> &pairs) {
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  bool ok = fillPairs(static_cast<const char *>(data), st.st_size, key, pairs);
+  munmap(data, st.st_size);
+  return ok;
+#else
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL)
+    return false;
+  vector<char> data;
+  char buffer[1 << 16];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+  return fillPairs(data.data(), data.size(), key, pairs);
+#endif
+}
@@ -0,0 +1,49 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+
+#ifndef LCSCACHE_H
+#define LCSCACHE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "GlobalDefs.h"
+
+/* header of a binary file with sorted pairwise LCS results
+   the header is followed by three int32 columns: geneA, geneB and lcslen */
+struct PairFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t key;
+  uint64_t count;
+};
+static const uint32_t PAIR_FILE_VERSION = 1;
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed);
+uint64_t lcsCacheKey(MatrixView<const int> values, Params const &params, bool useFib);
+uint64_t lcsShardKey(uint64_t key, int shard, int nShards);
+std::string lcsCachePath(std::string const &dir, uint64_t key);
+bool writePairFile(std::string const &path, uint64_t key, std::vector<triple> const &pairs);
+bool readPairFile(std::string const &path, uint64_t key, std::vector<triple> &pairs);
+#endif
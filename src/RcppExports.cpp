@@ -6,8 +6,8 @@
 using namespace Rcpp;
 
 // set_runibic_params
-void set_runibic_params(double t, double q, double f, int nbic, int div, bool useLegacy);
-RcppExport SEXP _runibic_set_runibic_params(SEXP tSEXP, SEXP qSEXP, SEXP fSEXP, SEXP nbicSEXP, SEXP divSEXP, SEXP useLegacySEXP) {
+void set_runibic_params(double t, double q, double f, int nbic, int div, bool useLegacy, int nthreads, std::string cacheDir, double maxMemory, std::string tracePath);
+RcppExport SEXP _runibic_set_runibic_params(SEXP tSEXP, SEXP qSEXP, SEXP fSEXP, SEXP nbicSEXP, SEXP divSEXP, SEXP useLegacySEXP, SEXP nthreadsSEXP, SEXP cacheDirSEXP, SEXP maxMemorySEXP, SEXP tracePathSEXP) {
 BEGIN_RCPP
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< double >::type t(tSEXP);
@@ -16,10 +16,24 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type nbic(nbicSEXP);
     Rcpp::traits::input_parameter< int >::type div(divSEXP);
     Rcpp::traits::input_parameter< bool >::type useLegacy(useLegacySEXP);
-    set_runibic_params(t, q, f, nbic, div, useLegacy);
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type cacheDir(cacheDirSEXP);
+    Rcpp::traits::input_parameter< double >::type maxMemory(maxMemorySEXP);
+    Rcpp::traits::input_parameter< std::string >::type tracePath(tracePathSEXP);
+    set_runibic_params(t, q, f, nbic, div, useLegacy, nthreads, cacheDir, maxMemory, tracePath);
     return R_NilValue;
 END_RCPP
 }
+// get_runibic_params
+Rcpp::List get_runibic_params();
+RcppExport SEXP _runibic_get_runibic_params() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(get_runibic_params());
+    return rcpp_result_gen;
+END_RCPP
+}
 // runiDiscretize
 Rcpp::IntegerMatrix runiDiscretize(Rcpp::NumericMatrix x);
 RcppExport SEXP _runibic_runiDiscretize(SEXP xSEXP) {
@@ -32,16 +46,38 @@ BEGIN_RCPP
 END_RCPP
 }
 // unisort
-Rcpp::IntegerMatrix unisort(Rcpp::IntegerMatrix x);
+Rcpp::IntegerMatrix unisort(SEXP x);
 RcppExport SEXP _runibic_unisort(SEXP xSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
     rcpp_result_gen = Rcpp::wrap(unisort(x));
     return rcpp_result_gen;
 END_RCPP
 }
+// runiMatrix
+SEXP runiMatrix(Rcpp::IntegerMatrix discreteInput);
+RcppExport SEXP _runibic_runiMatrix(SEXP discreteInputSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    rcpp_result_gen = Rcpp::wrap(runiMatrix(discreteInput));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runiSparseMatrix
+SEXP runiSparseMatrix(Rcpp::S4 x);
+RcppExport SEXP _runibic_runiSparseMatrix(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::S4 >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(runiSparseMatrix(x));
+    return rcpp_result_gen;
+END_RCPP
+}
 // pairwiseLCS
 Rcpp::IntegerMatrix pairwiseLCS(Rcpp::IntegerVector x, Rcpp::IntegerVector y);
 RcppExport SEXP _runibic_pairwiseLCS(SEXP xSEXP, SEXP ySEXP) {
@@ -67,43 +103,198 @@ BEGIN_RCPP
 END_RCPP
 }
 // calculateLCS
-Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap);
+Rcpp::List calculateLCS(SEXP discreteInput, bool useFibHeap);
 RcppExport SEXP _runibic_calculateLCS(SEXP discreteInputSEXP, SEXP useFibHeapSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type discreteInput(discreteInputSEXP);
     Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
     rcpp_result_gen = Rcpp::wrap(calculateLCS(discreteInput, useFibHeap));
     return rcpp_result_gen;
 END_RCPP
 }
-// cluster
-Rcpp::List cluster(Rcpp::IntegerMatrix discreteInput, Rcpp::IntegerMatrix discreteInputValues, Rcpp::IntegerVector scores, Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber);
-RcppExport SEXP _runibic_cluster(SEXP discreteInputSEXP, SEXP discreteInputValuesSEXP, SEXP scoresSEXP, SEXP geneOneSEXP, SEXP geneTwoSEXP, SEXP rowNumberSEXP, SEXP colNumberSEXP) {
+// updateLCS
+Rcpp::List updateLCS(Rcpp::IntegerMatrix discreteInput, Rcpp::List previous, int nOld, bool useFibHeap);
+RcppExport SEXP _runibic_updateLCS(SEXP discreteInputSEXP, SEXP previousSEXP, SEXP nOldSEXP, SEXP useFibHeapSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type previous(previousSEXP);
+    Rcpp::traits::input_parameter< int >::type nOld(nOldSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    rcpp_result_gen = Rcpp::wrap(updateLCS(discreteInput, previous, nOld, useFibHeap));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calculateLCSShard
+double calculateLCSShard(Rcpp::IntegerMatrix discreteInput, int shard, int nShards, std::string path, bool useFibHeap);
+RcppExport SEXP _runibic_calculateLCSShard(SEXP discreteInputSEXP, SEXP shardSEXP, SEXP nShardsSEXP, SEXP pathSEXP, SEXP useFibHeapSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< int >::type shard(shardSEXP);
+    Rcpp::traits::input_parameter< int >::type nShards(nShardsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculateLCSShard(discreteInput, shard, nShards, path, useFibHeap));
+    return rcpp_result_gen;
+END_RCPP
+}
+// mergeLCSShards
+Rcpp::List mergeLCSShards(Rcpp::IntegerMatrix discreteInput, std::vector<std::string> paths, bool useFibHeap);
+RcppExport SEXP _runibic_mergeLCSShards(SEXP discreteInputSEXP, SEXP pathsSEXP, SEXP useFibHeapSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type paths(pathsSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    rcpp_result_gen = Rcpp::wrap(mergeLCSShards(discreteInput, paths, useFibHeap));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calculateLCSScreened
+Rcpp::List calculateLCSScreened(Rcpp::IntegerMatrix discreteInput, int bands, int bandWidth, bool useFibHeap, int seed);
+RcppExport SEXP _runibic_calculateLCSScreened(SEXP discreteInputSEXP, SEXP bandsSEXP, SEXP bandWidthSEXP, SEXP useFibHeapSEXP, SEXP seedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
-    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInputValues(discreteInputValuesSEXP);
+    Rcpp::traits::input_parameter< int >::type bands(bandsSEXP);
+    Rcpp::traits::input_parameter< int >::type bandWidth(bandWidthSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculateLCSScreened(discreteInput, bands, bandWidth, useFibHeap, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calculateLCSTwoStage
+Rcpp::List calculateLCSTwoStage(Rcpp::IntegerMatrix discreteInput, double colFraction, double budget, bool useFibHeap, int seed);
+RcppExport SEXP _runibic_calculateLCSTwoStage(SEXP discreteInputSEXP, SEXP colFractionSEXP, SEXP budgetSEXP, SEXP useFibHeapSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< double >::type colFraction(colFractionSEXP);
+    Rcpp::traits::input_parameter< double >::type budget(budgetSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    Rcpp::traits::input_parameter< int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculateLCSTwoStage(discreteInput, colFraction, budget, useFibHeap, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cluster
+Rcpp::List cluster(SEXP discreteInput, SEXP discreteInputValues, Rcpp::IntegerVector scores, Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber, std::string streamPath);
+RcppExport SEXP _runibic_cluster(SEXP discreteInputSEXP, SEXP discreteInputValuesSEXP, SEXP scoresSEXP, SEXP geneOneSEXP, SEXP geneTwoSEXP, SEXP rowNumberSEXP, SEXP colNumberSEXP, SEXP streamPathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type discreteInputValues(discreteInputValuesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type scores(scoresSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type geneOne(geneOneSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type geneTwo(geneTwoSEXP);
+    Rcpp::traits::input_parameter< int >::type rowNumber(rowNumberSEXP);
+    Rcpp::traits::input_parameter< int >::type colNumber(colNumberSEXP);
+    Rcpp::traits::input_parameter< std::string >::type streamPath(streamPathSEXP);
+    rcpp_result_gen = Rcpp::wrap(cluster(discreteInput, discreteInputValues, scores, geneOne, geneTwo, rowNumber, colNumber, streamPath));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// clusterSweep
+Rcpp::List clusterSweep(SEXP discreteInput, SEXP discreteInputValues, Rcpp::IntegerVector scores, Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber, Rcpp::NumericVector t, Rcpp::NumericVector f, Rcpp::IntegerVector nbic);
+RcppExport SEXP _runibic_clusterSweep(SEXP discreteInputSEXP, SEXP discreteInputValuesSEXP, SEXP scoresSEXP, SEXP geneOneSEXP, SEXP geneTwoSEXP, SEXP rowNumberSEXP, SEXP colNumberSEXP, SEXP tSEXP, SEXP fSEXP, SEXP nbicSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type discreteInput(discreteInputSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type discreteInputValues(discreteInputValuesSEXP);
     Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type scores(scoresSEXP);
     Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type geneOne(geneOneSEXP);
     Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type geneTwo(geneTwoSEXP);
     Rcpp::traits::input_parameter< int >::type rowNumber(rowNumberSEXP);
     Rcpp::traits::input_parameter< int >::type colNumber(colNumberSEXP);
-    rcpp_result_gen = Rcpp::wrap(cluster(discreteInput, discreteInputValues, scores, geneOne, geneTwo, rowNumber, colNumber));
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type t(tSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type f(fSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type nbic(nbicSEXP);
+    rcpp_result_gen = Rcpp::wrap(clusterSweep(discreteInput, discreteInputValues, scores, geneOne, geneTwo, rowNumber, colNumber, t, f, nbic));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// readBiclusterStream
+Rcpp::List readBiclusterStream(std::string path);
+RcppExport SEXP _runibic_readBiclusterStream(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(readBiclusterStream(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// memoryEstimate
+Rcpp::List memoryEstimate(int rowNumber, int colNumber, bool useFibHeap, int settings);
+RcppExport SEXP _runibic_memoryEstimate(SEXP rowNumberSEXP, SEXP colNumberSEXP, SEXP useFibHeapSEXP, SEXP settingsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type rowNumber(rowNumberSEXP);
+    Rcpp::traits::input_parameter< int >::type colNumber(colNumberSEXP);
+    Rcpp::traits::input_parameter< bool >::type useFibHeap(useFibHeapSEXP);
+    Rcpp::traits::input_parameter< int >::type settings(settingsSEXP);
+    rcpp_result_gen = Rcpp::wrap(memoryEstimate(rowNumber, colNumber, useFibHeap, settings));
+    return rcpp_result_gen;
+END_RCPP
+}
+
+// peakMemory
+Rcpp::List peakMemory();
+RcppExport SEXP _runibic_peakMemory() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(peakMemory());
+    return rcpp_result_gen;
+END_RCPP
+}
+// pairStats
+Rcpp::List pairStats();
+RcppExport SEXP _runibic_pairStats() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(pairStats());
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_runibic_set_runibic_params", (DL_FUNC) &_runibic_set_runibic_params, 6},
+    {"_runibic_set_runibic_params", (DL_FUNC) &_runibic_set_runibic_params, 10},
+    {"_runibic_get_runibic_params", (DL_FUNC) &_runibic_get_runibic_params, 0},
     {"_runibic_runiDiscretize", (DL_FUNC) &_runibic_runiDiscretize, 1},
     {"_runibic_unisort", (DL_FUNC) &_runibic_unisort, 1},
+    {"_runibic_runiMatrix", (DL_FUNC) &_runibic_runiMatrix, 1},
+    {"_runibic_runiSparseMatrix", (DL_FUNC) &_runibic_runiSparseMatrix, 1},
     {"_runibic_pairwiseLCS", (DL_FUNC) &_runibic_pairwiseLCS, 2},
     {"_runibic_backtrackLCS", (DL_FUNC) &_runibic_backtrackLCS, 2},
     {"_runibic_calculateLCS", (DL_FUNC) &_runibic_calculateLCS, 2},
-    {"_runibic_cluster", (DL_FUNC) &_runibic_cluster, 7},
+    {"_runibic_updateLCS", (DL_FUNC) &_runibic_updateLCS, 4},
+    {"_runibic_calculateLCSShard", (DL_FUNC) &_runibic_calculateLCSShard, 5},
+    {"_runibic_mergeLCSShards", (DL_FUNC) &_runibic_mergeLCSShards, 3},
+    {"_runibic_calculateLCSScreened", (DL_FUNC) &_runibic_calculateLCSScreened, 5},
+    {"_runibic_calculateLCSTwoStage", (DL_FUNC) &_runibic_calculateLCSTwoStage, 5},
+    {"_runibic_cluster", (DL_FUNC) &_runibic_cluster, 8},
+    {"_runibic_clusterSweep", (DL_FUNC) &_runibic_clusterSweep, 10},
+    {"_runibic_readBiclusterStream", (DL_FUNC) &_runibic_readBiclusterStream, 1},
+    {"_runibic_memoryEstimate", (DL_FUNC) &_runibic_memoryEstimate, 4},
+    {"_runibic_peakMemory", (DL_FUNC) &_runibic_peakMemory, 0},
+    {"_runibic_pairStats", (DL_FUNC) &_runibic_pairStats, 0},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,86 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+
+#include <cstdio>
+#include "Trace.h"
+
+TraceRecorder gTrace;
+
+TraceRecorder::TraceRecorder(): Enabled(false), Origin(0), Threads(0) {
+  omp_init_lock(&Lock);
+}
+
+TraceRecorder::~TraceRecorder() {
+  omp_destroy_lock(&Lock);
+}
+
+/* starts a new trace written to path, unless it is already written there; an empty path stops tracing.
+   Returns false if the file cannot be written */
+bool TraceRecorder::start(std::string const &path) {
+  if (path == Path)
+    return true;
+  Path = path;
+  Events.clear();
+  Origin = omp_get_wtime();
+  Enabled = !Path.empty() && flush();
+  if (!Enabled)
+    Path.clear();
+  return Path == path;
+}
+
+/* threads are numbered in the order of their first span, so that threads of nested regions are told apart */
+int TraceRecorder::thread() {
+  static thread_local int id = -1;
+  if (id < 0) {
+    #pragma omp atomic capture
+    id = Threads++;
+  }
+  return id;
+}
+
+void TraceRecorder::record(const char *name, const char *argName, long arg, double begin, double end) {
+  Event event = {name, argName, arg, thread(), begin, end};
+  omp_set_lock(&Lock);
+  Events.push_back(event);
+  omp_unset_lock(&Lock);
+}
+
+/* rewrites the file with all spans recorded since start, times are in microseconds */
+bool TraceRecorder::flush() {
+  FILE *f = fopen(Path.c_str(), "w");
+  if (f == NULL)
+    return false;
+  fprintf(f, "{\"traceEvents\":[");
+  omp_set_lock(&Lock);
+  for (size_t i = 0; i < Events.size(); i++) {
+    Event const &e = Events[i];
+    fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"runibic\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f",
+            i > 0 ? "," : "", e.Name, e.Thread, (e.Begin - Origin) * 1e6, (e.End - e.Begin) * 1e6);
+    if (e.ArgName != NULL)
+      fprintf(f, ",\"args\":{\"%s\":%ld}", e.ArgName, e.Arg);
+    fprintf(f, "}");
+  }
+  omp_unset_lock(&Lock);
+  fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return fclose(f) == 0;
+}
@@ -0,0 +1,99 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <omp.h>
+
+/* spans of the stages, seeds and threads written as Chrome Trace Event JSON (chrome://tracing, Perfetto),
+   nothing is recorded unless start was given a file; spans are added to the file until another one is set */
+class TraceRecorder {
+public:
+  TraceRecorder();
+  ~TraceRecorder();
+
+  bool start(std::string const &path);
+  bool enabled() const { return Enabled; }
+  void record(const char *name, const char *argName, long arg, double begin, double end);
+  bool flush();
+
+private:
+  TraceRecorder(TraceRecorder const &);
+  TraceRecorder &operator=(TraceRecorder const &);
+  int thread();
+
+  struct Event {
+    const char *Name;
+    const char *ArgName; // NULL if the span has no argument
+    long Arg;
+    int Thread;
+    double Begin;
+    double End;
+  };
+  bool Enabled;
+  std::string Path;
+  std::vector<Event> Events;
+  omp_lock_t Lock;
+  double Origin;
+  int Threads;
+};
+
+extern TraceRecorder gTrace;
+
+/* records the time from its construction to its destruction on the calling thread,
+   name and argName must be literals */
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, const char *argName = NULL, long arg = 0)
+    : Name(gTrace.enabled() ? name : NULL), ArgName(argName), Arg(arg), Begin(Name != NULL ? omp_get_wtime() : 0) {};
+  ~TraceSpan() {
+    if (Name != NULL)
+      gTrace.record(Name, ArgName, Arg, Begin, omp_get_wtime());
+  }
+
+private:
+  const char *Name;
+  const char *ArgName;
+  long Arg;
+  double Begin;
+};
+
+/* span of a stage called from R or the command-line program, the file is rewritten at its end */
+class TraceStage {
+public:
+  explicit TraceStage(const char *name): Name(gTrace.enabled() ? name : NULL), Begin(Name != NULL ? omp_get_wtime() : 0) {};
+  ~TraceStage() {
+    if (Name != NULL) {
+      gTrace.record(Name, NULL, 0, Begin, omp_get_wtime());
+      gTrace.flush();
+    }
+  }
+
+private:
+  const char *Name;
+  double Begin;
+};
+#endif
@@ -0,0 +1,1125 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <set>
+#include <memory>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <numeric>
+#include <omp.h>
+#include "Unibic.h"
+#include "LCSCache.h"
+
+using namespace std;
+
+Params gParameters;
+StageMemory gPeakMemory;
+PairStats gPairStats;
+
+/* bytes of a cache of the seed loop with at most cap bytes, so that it fits in half
+   of the memory left by the other buffers of the stage */
+static size_t cacheBytes(size_t cap, size_t used, Params const &params) {
+  if (params.MaxMemory == 0)
+    return cap;
+  if (used >= params.MaxMemory)
+    return 0;
+  return std::min(cap, (params.MaxMemory - used) / 4);
+}
+
+/* length of the sequence of row i of m built by rowSequences */
+static size_t sparseRowLength(SparseRowMatrix const &m, const int i, const double quantile) {
+  if (quantile >= 0.5)
+    return m.NCol;
+  size_t stored = m.Offsets[i+1] - m.Offsets[i];
+  size_t length = m.Background[i] != 0 ? m.NCol - stored : 0;
+  for (auto k = m.Offsets[i]; k < m.Offsets[i+1]; k++)
+    length += m.Values[k] != 0;
+  return length;
+}
+
+/* upper bounds of the buffers of every stage for a matrix of nrow x ncol clustered with settings settings,
+   whose discrete input takes inputBytes and whose row sequences have cells columns in total,
+   pairs are streamed if there are more than HEAP_SIZE of them or scoring them at once does not fit in MaxMemory,
+   in chunks as large as the budget left by the pairs kept allows */
+static StageMemory stageMemory(const int nrow, const int ncol, const size_t inputBytes, const size_t cells, Params const &params,
+  bool useFib, const int settings) {
+  StageMemory m;
+  size_t index = indexBytes(ncol);
+  m.Input = inputBytes + index * cells + sizeof(size_t) * (nrow + 1);
+
+  size_t pairs = countPairs(nrow);
+  size_t kept = useFib ? std::min(pairs, static_cast<size_t>(HEAP_SIZE)) : pairs;
+  size_t direct = sizeof(triple) * (pairs + kept) + PairSelection::keptBytes(kept, useFib, false) + duplicateRowsBytes(nrow);
+  size_t fixed = sizeof(triple) * kept + PairSelection::keptBytes(kept, useFib, true) + duplicateRowsBytes(nrow);
+  size_t chunk = PAIR_CHUNK;
+  if (params.MaxMemory > 0) {
+    size_t left = params.MaxMemory > m.Input + fixed ? (params.MaxMemory - m.Input - fixed) / sizeof(triple) : 0;
+    chunk = std::max(PAIR_CHUNK_MIN, std::min(left, PAIR_CHUNK));
+  }
+  chunk = std::min(chunk, pairs);
+  size_t streamed = fixed + sizeof(triple) * chunk;
+  // past HEAP_SIZE pairs scoring them at once only costs memory, hundreds of thousands of rows have billions of pairs
+  m.StreamPairs = streamed < direct && (pairs > static_cast<size_t>(HEAP_SIZE) || (params.MaxMemory > 0 && m.Input + direct > params.MaxMemory));
+  m.Pairs = m.StreamPairs ? streamed : direct;
+  m.PairChunk = m.StreamPairs ? chunk : 0;
+
+  // every setting has the tags of all rows for the seed, the columns and the reverse pass, and per row vectors
+  size_t arena = 3 * (index * cells + sizeof(size_t) * (nrow + 1)) + 48 * static_cast<size_t>(nrow)
+    + params.NumThreads() * 16 * static_cast<size_t>(ncol + 1);
+  m.Cluster = sizeof(triple) * kept + sizeof(uint64_t) * nrow * ((ncol + 63) / 64) + std::min(settings, params.NumThreads()) * arena;
+  // the filtered blocks, and at most SchBlock of them before filtering
+  m.Output = settings * sizeof(int) * static_cast<size_t>(params.RptBlock + params.SchBlock) * (nrow + ncol);
+  if (settings > 1) {
+    size_t used = m.Input + m.Cluster + m.Output;
+    m.TagCache = cacheBytes(SWEEP_TAG_CACHE_BYTES, used, params);
+    m.PairCache = cacheBytes(PAIR_TAG_CACHE_BYTES, used, params);
+    m.Cluster += m.TagCache + m.PairCache;
+  }
+  return m;
+}
+
+/* estimate for a dense matrix of nrow x ncol, whose values and index matrix are integer matrices */
+StageMemory estimateMemory(const int nrow, const int ncol, Params const &params, bool useFib, const int settings) {
+  size_t cells = static_cast<size_t>(nrow) * ncol;
+  return stageMemory(nrow, ncol, 2 * sizeof(int) * cells, cells, params, useFib, settings);
+}
+
+/* estimate for a sparse matrix, whose row sequences keep only the columns with nonzero levels for Quantile < 0.5 */
+StageMemory estimateMemory(SparseRowMatrix const &m, Params const &params, bool useFib, const int settings) {
+  size_t cells = 0;
+  for (auto i = 0; i < m.NRow; i++)
+    cells += sparseRowLength(m, i, params.Quantile);
+  return stageMemory(m.NRow, m.NCol, m.bytes(), cells, params, useFib, settings);
+}
+
+/* message for a stage whose buffers need more than MaxMemory, empty if they fit */
+std::string memoryError(const char *stage, size_t bytes, Params const &params) {
+  if (params.MaxMemory == 0 || bytes <= params.MaxMemory)
+    return "";
+  std::ostringstream message;
+  message << std::fixed << std::setprecision(1) << "the " << stage << " stage needs about " << bytes / 1048576.0
+          << " MB, more than maxMemory (" << params.MaxMemory / 1048576.0 << " MB)";
+  return message.str();
+}
+
+/* discrete level of value among the sorted values rowData of its row for Quantile >= 0.5, 0 if it has none */
+template<typename V>
+static int rankLevel(double value, V const &rowData, int nc) {
+  double dSpace = 1.0 / gParameters.Divided;
+  for(auto ind=0; ind < gParameters.Divided; ind++){
+    if(value >= calculateQuantile(rowData, nc, 1.0 - dSpace * (ind+1)))
+      return ind+1;
+  }
+  return 0;
+}
+
+/* limits beyond which the values of a row with sorted values rowData are up or down-regulated for Quantile < 0.5 */
+template<typename V>
+static void regulatedLimits(V const &rowData, int nc, double &lowerLimit, double &upperLimit) {
+  double partOne = calculateQuantile(rowData,nc,1-gParameters.Quantile);
+  double partTwo = calculateQuantile(rowData,nc,gParameters.Quantile);
+  double partThree = calculateQuantile(rowData, nc, 0.5);
+
+  if((partOne-partThree) >= (partThree - partTwo)){
+    upperLimit = 2*partThree - partTwo;
+    lowerLimit = partTwo;
+  }
+  else{
+    upperLimit = partOne;
+    lowerLimit = 2*partThree - partOne;
+  }
+}
+
+/* discrete level of value from the sorted down and up-regulated values of its row for Quantile < 0.5, 0 if it has none */
+template<typename V>
+static int regulatedLevel(double value, V const &lowerPart, V const &upperPart) {
+  double dSpace = 1.0 / gParameters.Divided;
+  for(auto ind=0; ind < gParameters.Divided; ind++){
+    if(lowerPart.size() > 0 && value <= calculateQuantile(lowerPart, lowerPart.size(), dSpace * (ind+1)))
+      return -ind-1;
+    if(upperPart.size() > 0 && value >= calculateQuantile(upperPart, upperPart.size(), 1.0 - dSpace * (ind+1)))
+      return ind+1;
+  }
+  return 0;
+}
+
+/* discretization of runiDiscretize */
+void discretizeMatrix(MatrixView<const double> x, MatrixView<int> y) {
+  gParameters.InitOptions(x.nrow(),x.ncol());
+  TraceStage stage("discretize");
+  int nr = x.nrow();
+  int nc = x.ncol();
+  // missing values are placed at the end as in Rcpp::NumericVector::sort
+  auto lessNaLast = [](double lhs, double rhs) { return lhs < rhs || (!std::isnan(lhs) && std::isnan(rhs)); };
+
+  vector<double> rowData;
+  if(gParameters.Quantile >=0.5){
+    #pragma omp parallel for private(rowData) num_threads(gParameters.NumThreads())
+    for(auto iRow = 0; iRow < nr; iRow++){
+      rowData.resize(nc);
+      for(auto iCol = 0; iCol < nc; iCol++)
+        rowData[iCol] = x(iRow,iCol);
+      sort(rowData.begin(), rowData.end(), lessNaLast);
+
+      for(auto iCol = 0; iCol < nc; iCol++)
+        y(iRow,iCol) = rankLevel(x(iRow,iCol), rowData, nc);
+    }
+  }
+  else{
+    vector<double> upperPart, lowerPart;
+    #pragma omp parallel for private(rowData, upperPart, lowerPart) num_threads(gParameters.NumThreads())
+    for(auto iRow = 0; iRow < nr; iRow++){
+      rowData.resize(nc);
+      for(auto iCol = 0; iCol < nc; iCol++)
+        rowData[iCol] = x(iRow,iCol);
+      stable_sort(rowData.begin(), rowData.end(), lessNaLast);
+
+      double upperLimit, lowerLimit;
+      regulatedLimits(rowData, nc, lowerLimit, upperLimit);
+      upperPart.clear();
+      lowerPart.clear();
+      copy_if(rowData.begin(), rowData.end(), back_inserter(upperPart), [&](double v) { return v > upperLimit; });
+      copy_if(rowData.begin(), rowData.end(), back_inserter(lowerPart), [&](double v) { return v < lowerLimit; });
+      for(auto iCol = 0; iCol < nc; iCol++)
+        y(iRow,iCol) = regulatedLevel(x(iRow,iCol), lowerPart, upperPart);
+    }
+  }
+}
+
+/* sorted values of a row of a sparse matrix read by position as the sorted row of discretizeMatrix,
+   the zeros which are not stored are only counted and read in their place before the positive values */
+struct SparseRowValues {
+  std::vector<double> Stored; // sorted with missing values last
+  size_t ZeroAt; // number of negative values in Stored
+  size_t Zeros;
+  SparseRowValues(): ZeroAt(0), Zeros(0) {};
+
+  size_t size() const { return Stored.size() + Zeros; }
+  double operator[](size_t i) const { return i < ZeroAt ? Stored[i] : (i < ZeroAt + Zeros ? 0.0 : Stored[i - Zeros]); }
+
+  /* the values for which keep is true, in the same order */
+  template<typename F>
+  void select(SparseRowValues &part, F keep) const {
+    part.Stored.clear();
+    part.ZeroAt = 0;
+    for (auto it = Stored.begin(); it != Stored.end(); it++) {
+      if (keep(*it)) {
+        part.Stored.push_back(*it);
+        part.ZeroAt += *it < 0;
+      }
+    }
+    part.Zeros = keep(0.0) ? Zeros : 0;
+  }
+};
+
+/* discretization of runiDiscretize for a sparse matrix, the levels of every row are taken from
+   its stored values and the count of its zeros, which share one level kept in Background */
+void discretizeSparse(SparseColumnView x, SparseRowMatrix &y) {
+  gParameters.InitOptions(x.NRow, x.NCol);
+  TraceStage stage("discretize");
+  int nr = x.NRow;
+  int nc = x.NCol;
+  auto lessNaLast = [](double lhs, double rhs) { return lhs < rhs || (!std::isnan(lhs) && std::isnan(rhs)); };
+
+  // the entries are moved to their rows by counting the entries of every row, the columns of a row stay ascending
+  size_t entries = x.ColStart[nc];
+  y.NRow = nr;
+  y.NCol = nc;
+  y.Offsets.assign(nr + 1, 0);
+  for (size_t k = 0; k < entries; k++)
+    y.Offsets[x.Rows[k] + 1]++;
+  partial_sum(y.Offsets.begin(), y.Offsets.end(), y.Offsets.begin());
+  y.Cols.resize(entries);
+  y.Values.resize(entries);
+  y.Background.assign(nr, 0);
+  vector<double> stored(entries);
+  vector<size_t> next(y.Offsets.begin(), y.Offsets.end() - 1);
+  for (auto j = 0; j < nc; j++) {
+    for (auto k = x.ColStart[j]; k < x.ColStart[j+1]; k++) {
+      size_t at = next[x.Rows[k]]++;
+      y.Cols[at] = j;
+      stored[at] = x.Values[k];
+    }
+  }
+
+  SparseRowValues rowData, upperPart, lowerPart;
+  #pragma omp parallel for private(rowData, upperPart, lowerPart) schedule(dynamic, 64) num_threads(gParameters.NumThreads())
+  for (auto iRow = 0; iRow < nr; iRow++) {
+    size_t first = y.Offsets[iRow], last = y.Offsets[iRow+1];
+    rowData.Stored.assign(stored.begin() + first, stored.begin() + last);
+    sort(rowData.Stored.begin(), rowData.Stored.end(), lessNaLast);
+    rowData.ZeroAt = count_if(rowData.Stored.begin(), rowData.Stored.end(), [](double v) { return v < 0; });
+    rowData.Zeros = nc - (last - first);
+    if (gParameters.Quantile >= 0.5) {
+      for (auto k = first; k < last; k++)
+        y.Values[k] = rankLevel(stored[k], rowData, nc);
+      if (rowData.Zeros > 0)
+        y.Background[iRow] = rankLevel(0.0, rowData, nc);
+    }
+    else {
+      double upperLimit, lowerLimit;
+      regulatedLimits(rowData, nc, lowerLimit, upperLimit);
+      rowData.select(upperPart, [&](double v) { return v > upperLimit; });
+      rowData.select(lowerPart, [&](double v) { return v < lowerLimit; });
+      for (auto k = first; k < last; k++)
+        y.Values[k] = regulatedLevel(stored[k], lowerPart, upperPart);
+      if (rowData.Zeros > 0)
+        y.Background[iRow] = regulatedLevel(0.0, lowerPart, upperPart);
+    }
+  }
+}
+
+/* indices of the j-th smallest values of each row as in unisort */
+void sortRowIndices(MatrixView<const int> x, MatrixView<int> y) {
+  int nr = x.nrow();
+  int nc = x.ncol();
+  gParameters.InitOptions(nr,nc);
+  TraceStage stage("unisort");
+  #pragma omp parallel num_threads(gParameters.NumThreads())
+  {
+    // every thread starts from its own empty buffer
+    vector< pair<int,int> > a;
+    a.reserve(nc);
+    TraceSpan span("unisort rows");
+    #pragma omp for nowait
+    for (auto  j=0; j<nr; j++) {
+      a.clear();
+      for (auto  i=0; i<nc; i++) {
+        a.push_back(std::make_pair(x(j,i),i));
+      }
+
+      stable_sort(a.begin(), a.end());
+      if(gParameters.Quantile < 0.5){
+        int ind=0;
+        for (auto  i=0; i<nc; i++) {
+          if(a[i].first == 0){
+            ind = i;
+            break;
+          }
+        } 
+        rotate(a.begin(), a.begin()+ind+1,a.end());
+      }
+      for (auto  i=0; i<nc; i++) {
+        y(j,i)=a[i].second;
+      }
+    }
+  }
+}
+
+/* copy the rows of the index matrix to a RowSet,
+   for Quantile < 0.5 columns with zero discrete value are skipped */
+template<typename T>
+void rowSequences(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, RowSet<T> &discreteInputData) {
+  discreteInputData.clear();
+  discreteInputData.Values.reserve(static_cast<size_t>(discreteInputIndex.nrow()) * discreteInputIndex.ncol());
+  discreteInputData.Offsets.reserve(discreteInputIndex.nrow() + 1);
+  for (auto i = 0; i < discreteInputIndex.nrow(); i++) {
+    if(gParameters.Quantile < 0.5){
+      for (auto j = 0; j < discreteInputIndex.ncol(); j++){
+        if(discreteInputValues(i, discreteInputIndex(i, j))!=0)
+          discreteInputData.Values.push_back(discreteInputIndex(i, j));
+      } 
+    }
+    else{
+      for (auto j = 0; j < discreteInputIndex.ncol(); j++){
+        discreteInputData.Values.push_back(discreteInputIndex(i, j));
+      } 
+    }
+    discreteInputData.Offsets.push_back(discreteInputData.Values.size());
+  }
+}
+
+/* row sequences of a sparse matrix, the same as those of its index matrix built from the stored entries:
+   for Quantile < 0.5 a row keeps the columns with nonzero levels, after the rotation of sortRowIndices
+   the up-regulated ones come before the down-regulated ones, and its zeros are kept only if their level is not zero */
+template<typename T>
+void rowSequences(SparseRowMatrix const &m, RowSet<T> &discreteInputData) {
+  discreteInputData.clear();
+  discreteInputData.Offsets.resize(m.NRow + 1);
+  for (auto i = 0; i < m.NRow; i++)
+    discreteInputData.Offsets[i+1] = discreteInputData.Offsets[i] + sparseRowLength(m, i, gParameters.Quantile);
+  discreteInputData.Values.resize(discreteInputData.Offsets[m.NRow]);
+  bool regulated = gParameters.Quantile < 0.5;
+  #pragma omp parallel num_threads(gParameters.NumThreads())
+  {
+    vector< pair<int,int> > a;
+    #pragma omp for schedule(dynamic, 64)
+    for (auto i = 0; i < m.NRow; i++) {
+      size_t first = m.Offsets[i], last = m.Offsets[i+1];
+      int background = m.Background[i];
+      bool zeros = last - first < static_cast<size_t>(m.NCol);
+      bool hasZero = zeros && background == 0;
+      a.clear();
+      if (!regulated || (zeros && background != 0)) {
+        size_t k = first;
+        for (auto j = 0; j < m.NCol; j++) {
+          if (k < last && m.Cols[k] == j)
+            k++;
+          else
+            a.push_back(std::make_pair(background, j));
+        }
+      }
+      for (auto k = first; k < last; k++) {
+        if (!regulated || m.Values[k] != 0)
+          a.push_back(std::make_pair(m.Values[k], m.Cols[k]));
+        else
+          hasZero = true;
+      }
+      sort(a.begin(), a.end());
+      if (regulated && !a.empty()) {
+        if (hasZero)
+          rotate(a.begin(), upper_bound(a.begin(), a.end(), std::make_pair(0, m.NCol)), a.end());
+        else
+          rotate(a.begin(), a.begin() + 1, a.end());
+      }
+      T *out = discreteInputData.Values.data() + discreteInputData.Offsets[i];
+      for (size_t j = 0; j < a.size(); j++)
+        out[j] = static_cast<T>(a[j].second);
+    }
+  }
+}
+
+/* the helpers below build row sequences with index type T selected by indexBytes */
+template<typename T>
+static void allPairsLCS(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, std::vector<triple> &out, bool useFib,
+  StageMemory &peak) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  peak.Input += discreteInputData.bytes();
+  peak.Pairs = internalCalulateLCS(discreteInputData, out, useFib, peak.PairChunk);
+}
+
+template<typename T>
+static void allPairsLCS(SparseRowMatrix const &m, std::vector<triple> &out, bool useFib, StageMemory &peak) {
+  RowSet<T> discreteInputData;
+  rowSequences(m, discreteInputData);
+  peak.Input += discreteInputData.bytes();
+  peak.Pairs = internalCalulateLCS(discreteInputData, out, useFib, peak.PairChunk);
+}
+
+template<typename T>
+static void newPairsLCS(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, const int firstNew,
+  std::vector<triple> const &previous, std::vector<triple> &out, bool useFib) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  internalIncrementalLCS(discreteInputData, firstNew, previous, out, useFib);
+}
+
+template<typename T>
+static void scoreRowPairs(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, std::vector<triple> &triplets) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  scorePairs(discreteInputData, triplets);
+}
+
+template<typename T>
+static void pairRangeLCS(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, const size_t first, const size_t last,
+  const int minLength, std::vector<triple> &out) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  internalPairRange(discreteInputData, first, last, minLength, out);
+}
+
+template<typename T>
+static void screenedPairsLCS(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, const int bands, const int bandWidth,
+  const int seed, std::vector<triple> &triplets) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  screenPairs(discreteInputData, discreteInputIndex.ncol(), bands, bandWidth, seed, triplets);
+  scorePairs(discreteInputData, triplets);
+}
+
+template<typename T>
+static void twoStagePairsLCS(MatrixView<const int> discreteInputIndex, MatrixView<const int> discreteInputValues, const double colFraction, const size_t budget,
+  const int seed, std::vector<triple> &triplets) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInputIndex, discreteInputValues, discreteInputData);
+  subsamplePairs(discreteInputData, discreteInputIndex.ncol(), colFraction, budget, seed, triplets);
+  scorePairs(discreteInputData, triplets);
+}
+
+/* bytes of the blocks found for every setting */
+static size_t blockBytes(std::vector<std::vector<BicBlock*>> const &outputs) {
+  size_t size = 0;
+  for (auto it = outputs.begin(); it != outputs.end(); it++)
+    for (auto jt = it->begin(); jt != it->end(); jt++)
+      size += sizeof(BicBlock) + vectorBytes((*jt)->genes) + vectorBytes((*jt)->conds);
+  return size;
+}
+
+/* clusters every setting, in parallel and sharing the lcs of the seeds if there are several,
+   the caches of several settings are limited to fit in MaxMemory */
+template<typename T>
+static void clusterRows(std::vector<Params> &settings, RowSet<T> const &discreteInputData, const size_t inputBytes, StageMemory const &need,
+  std::vector<uint64_t> const &nonzeroMask, std::vector<triple> const &seeds, const int rowNumber, const int colNumber, std::vector<std::vector<BicBlock*>> &outputs,
+  std::vector<ClusterStats> &stats, std::vector<BlockSink*> const &sinks) {
+  int numSettings = settings.size();
+  outputs.assign(numSettings, vector<BicBlock*>());
+  stats.assign(numSettings, ClusterStats());
+  size_t cacheSize = 0;
+  if (numSettings == 1)
+    internalCluster<T>(&settings[0], discreteInputData, nonzeroMask, seeds, rowNumber, colNumber, outputs[0], NULL, NULL, &stats[0], sinks.empty() ? NULL : sinks[0]);
+  else {
+    SeedTagCache<T> tagCache(need.TagCache);
+    // the settings expand the same seeds, so the lcs of their rows repeat between settings
+    PairTagCache<T> pairCache(need.PairCache);
+    #pragma omp parallel for schedule(dynamic) num_threads(gParameters.NumThreads())
+    for (auto i = 0; i < numSettings; i++)
+      internalCluster<T>(&settings[i], discreteInputData, nonzeroMask, seeds, rowNumber, colNumber, outputs[i], &tagCache, &pairCache, &stats[i], sinks.empty() ? NULL : sinks[i]);
+    cacheSize = tagCache.Bytes + pairCache.bytes();
+  }
+  gPeakMemory.Input = inputBytes + discreteInputData.bytes();
+  gPeakMemory.Cluster = sizeof(triple) * seeds.capacity() + vectorBytes(nonzeroMask) + cacheSize;
+  for (auto it = stats.begin(); it != stats.end(); it++)
+    gPeakMemory.Cluster += it->ScratchBytes;
+  gPeakMemory.Output = blockBytes(outputs);
+}
+
+template<typename T>
+static void clusterMatrix(std::vector<Params> &settings, MatrixView<const int> discreteInput, MatrixView<const int> discreteInputValues,
+  std::vector<uint64_t> const &nonzeroMask, std::vector<triple> const &seeds, const int rowNumber, const int colNumber, std::vector<std::vector<BicBlock*>> &outputs,
+  std::vector<ClusterStats> &stats, std::vector<BlockSink*> const &sinks) {
+  RowSet<T> discreteInputData;
+  rowSequences(discreteInput, discreteInputValues, discreteInputData);
+  clusterRows(settings, discreteInputData, 2 * sizeof(int) * static_cast<size_t>(rowNumber) * colNumber,
+    estimateMemory(rowNumber, colNumber, gParameters, true, settings.size()), nonzeroMask, seeds, rowNumber, colNumber, outputs, stats, sinks);
+}
+
+template<typename T>
+static void clusterSparse(std::vector<Params> &settings, SparseRowMatrix const &m, std::vector<uint64_t> const &nonzeroMask, std::vector<triple> const &seeds,
+  std::vector<std::vector<BicBlock*>> &outputs, std::vector<ClusterStats> &stats, std::vector<BlockSink*> const &sinks) {
+  RowSet<T> discreteInputData;
+  rowSequences(m, discreteInputData);
+  clusterRows(settings, discreteInputData, m.bytes(), estimateMemory(m, gParameters, true, settings.size()), nonzeroMask, seeds, m.NRow, m.NCol,
+    outputs, stats, sinks);
+}
+
+/* the index matrix of sortRowIndices stored in buffer */
+static MatrixView<const int> sortedIndex(MatrixView<const int> values, std::vector<int> &buffer) {
+  buffer.resize(static_cast<size_t>(values.nrow()) * values.ncol());
+  sortRowIndices(values, MatrixView<int>(buffer.data(), values.nrow(), values.ncol()));
+  return MatrixView<const int>(buffer.data(), values.nrow(), values.ncol());
+}
+
+/* row-major copy of values, transposed in tiles so that both the reads and the writes stay in cache */
+void rowMajorMatrix(MatrixView<const int> values, RowMajorMatrix &m) {
+  const int TILE = 64;
+  m.NRow = values.nrow();
+  m.NCol = values.ncol();
+  m.Values.resize(static_cast<size_t>(m.NRow) * m.NCol);
+  m.Index.clear();
+  MatrixView<int> y(m.Values.data(), m.NRow, m.NCol, true);
+  for (auto i0 = 0; i0 < m.NRow; i0 += TILE)
+    for (auto j0 = 0; j0 < m.NCol; j0 += TILE)
+      for (auto j = j0; j < std::min(j0 + TILE, m.NCol); j++)
+        for (auto i = i0; i < std::min(i0 + TILE, m.NRow); i++)
+          y(i, j) = values(i, j);
+}
+
+/* row-major index matrix of m, sorted again when Quantile has changed since it was calculated */
+MatrixView<const int> rowMajorIndex(RowMajorMatrix &m) {
+  if (m.Index.empty() || (m.IndexQuantile < 0.5) != (gParameters.Quantile < 0.5)) {
+    m.Index.resize(m.Values.size());
+    sortRowIndices(m.values(), MatrixView<int>(m.Index.data(), m.NRow, m.NCol, true));
+    m.IndexQuantile = gParameters.Quantile;
+  }
+  return MatrixView<const int>(m.Index.data(), m.NRow, m.NCol, true);
+}
+
+/* pairs of rows ordered by lcs as in calculateLCS, reusing the file in CacheDir if it is set,
+   cachePath is set to that file and false is returned if it could not be written,
+   index is the index matrix of sortRowIndices if it has already been calculated */
+bool lcsAllPairs(MatrixView<const int> values, bool useFib, std::vector<triple> &out, std::string &cachePath,
+  MatrixView<const int> const *index) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  gParameters.InitOptions(values.nrow(), values.ncol());
+  uint64_t cacheKey = 0;
+  cachePath.clear();
+  if (!gParameters.CacheDir.empty()) {
+    cacheKey = lcsCacheKey(values, gParameters, useFib);
+    cachePath = lcsCachePath(gParameters.CacheDir, cacheKey);
+    if (readPairFile(cachePath, cacheKey, out)) {
+      gPeakMemory.Input = sizeof(int) * static_cast<size_t>(values.nrow()) * values.ncol();
+      gPeakMemory.Pairs = sizeof(triple) * out.capacity();
+      gPeakMemory.StreamPairs = false;
+      return true;
+    }
+  }
+
+  vector<int> buffer;
+  MatrixView<const int> sorted = index != NULL ? *index : sortedIndex(values, buffer);
+  size_t pairs = countPairs(sorted.nrow());
+  out.reserve(useFib ? std::min(pairs, static_cast<size_t>(HEAP_SIZE)) : pairs);
+  StageMemory peak;
+  StageMemory estimate = estimateMemory(values.nrow(), values.ncol(), gParameters, useFib);
+  peak.StreamPairs = estimate.StreamPairs;
+  peak.PairChunk = estimate.PairChunk;
+  peak.Input = 2 * sizeof(int) * static_cast<size_t>(values.nrow()) * values.ncol();
+  switch (indexBytes(sorted.ncol())) {
+    case 1: allPairsLCS<uint8_t>(sorted, values, out, useFib, peak); break;
+    case 2: allPairsLCS<uint16_t>(sorted, values, out, useFib, peak); break;
+    default: allPairsLCS<int>(sorted, values, out, useFib, peak);
+  }
+  gPeakMemory.Input = peak.Input;
+  gPeakMemory.Pairs = peak.Pairs + sizeof(triple) * out.capacity();
+  gPeakMemory.StreamPairs = peak.StreamPairs;
+  return cachePath.empty() || writePairFile(cachePath, cacheKey, out);
+}
+
+/* key of the pair file of a sparse matrix, which differs from the key of the same dense matrix */
+static uint64_t lcsCacheKey(SparseRowMatrix const &m, Params const &params, bool useFib) {
+  uint64_t h = 14695981039346656037ULL;
+  int32_t settings[7] = {m.NRow, m.NCol, params.Divided, params.ColWidth, 4 /* PART */, useFib ? 1 : 0, 1 /* sparse */};
+  h = hashBytes(settings, sizeof(settings), h);
+  h = hashBytes(&params.Quantile, sizeof(params.Quantile), h);
+  h = hashBytes(&PAIR_FILE_VERSION, sizeof(PAIR_FILE_VERSION), h);
+  h = hashBytes(m.Offsets.data(), vectorBytes(m.Offsets), h);
+  h = hashBytes(m.Cols.data(), sizeof(int) * m.Cols.size(), h);
+  h = hashBytes(m.Values.data(), sizeof(int) * m.Values.size(), h);
+  return hashBytes(m.Background.data(), sizeof(int) * m.Background.size(), h);
+}
+
+/* lcsAllPairs for a sparse matrix, whose row sequences are built from its stored entries */
+bool lcsAllPairs(SparseRowMatrix const &m, bool useFib, std::vector<triple> &out, std::string &cachePath) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  gParameters.InitOptions(m.NRow, m.NCol);
+  uint64_t cacheKey = 0;
+  cachePath.clear();
+  if (!gParameters.CacheDir.empty()) {
+    cacheKey = lcsCacheKey(m, gParameters, useFib);
+    cachePath = lcsCachePath(gParameters.CacheDir, cacheKey);
+    if (readPairFile(cachePath, cacheKey, out)) {
+      gPeakMemory.Input = m.bytes();
+      gPeakMemory.Pairs = sizeof(triple) * out.capacity();
+      gPeakMemory.StreamPairs = false;
+      return true;
+    }
+  }
+
+  size_t pairs = countPairs(m.NRow);
+  out.reserve(useFib ? std::min(pairs, static_cast<size_t>(HEAP_SIZE)) : pairs);
+  StageMemory peak;
+  StageMemory estimate = estimateMemory(m, gParameters, useFib);
+  peak.StreamPairs = estimate.StreamPairs;
+  peak.PairChunk = estimate.PairChunk;
+  peak.Input = m.bytes();
+  switch (indexBytes(m.NCol)) {
+    case 1: allPairsLCS<uint8_t>(m, out, useFib, peak); break;
+    case 2: allPairsLCS<uint16_t>(m, out, useFib, peak); break;
+    default: allPairsLCS<int>(m, out, useFib, peak);
+  }
+  gPeakMemory.Input = peak.Input;
+  gPeakMemory.Pairs = peak.Pairs + sizeof(triple) * out.capacity();
+  gPeakMemory.StreamPairs = peak.StreamPairs;
+  return cachePath.empty() || writePairFile(cachePath, cacheKey, out);
+}
+
+/* pairs of lcsAllPairs of all rows as in updateLCS, the ones of rows before firstNew found in previous are not scored again */
+void lcsNewPairs(MatrixView<const int> values, const int firstNew, std::vector<triple> const &previous, std::vector<triple> &out, bool useFib) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  vector<int> buffer;
+  MatrixView<const int> index = sortedIndex(values, buffer);
+  switch (indexBytes(index.ncol())) {
+    case 1: newPairsLCS<uint8_t>(index, values, firstNew, previous, out, useFib); break;
+    case 2: newPairsLCS<uint16_t>(index, values, firstNew, previous, out, useFib); break;
+    default: newPairsLCS<int>(index, values, firstNew, previous, out, useFib);
+  }
+}
+
+/* lcs of the given pairs of rows, the pairs are not reordered */
+void lcsScorePairs(MatrixView<const int> values, std::vector<triple> &triplets) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  vector<int> buffer;
+  MatrixView<const int> index = sortedIndex(values, buffer);
+  switch (indexBytes(index.ncol())) {
+    case 1: scoreRowPairs<uint8_t>(index, values, triplets); break;
+    case 2: scoreRowPairs<uint16_t>(index, values, triplets); break;
+    default: scoreRowPairs<int>(index, values, triplets);
+  }
+}
+
+/* pairs with positions [first, last) of lcsAllPairs with lcs of at least minLength, scored in bounded chunks */
+void lcsPairRange(MatrixView<const int> values, const size_t first, const size_t last, const int minLength, std::vector<triple> &out) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  vector<int> buffer;
+  MatrixView<const int> index = sortedIndex(values, buffer);
+  switch (indexBytes(index.ncol())) {
+    case 1: pairRangeLCS<uint8_t>(index, values, first, last, minLength, out); break;
+    case 2: pairRangeLCS<uint16_t>(index, values, first, last, minLength, out); break;
+    default: pairRangeLCS<int>(index, values, first, last, minLength, out);
+  }
+}
+
+/* lcs of the pairs proposed by screenPairs, not ordered */
+void lcsScreenedPairs(MatrixView<const int> values, const int bands, const int bandWidth, const int seed, std::vector<triple> &triplets) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  vector<int> buffer;
+  MatrixView<const int> index = sortedIndex(values, buffer);
+  switch (indexBytes(index.ncol())) {
+    case 1: screenedPairsLCS<uint8_t>(index, values, bands, bandWidth, seed, triplets); break;
+    case 2: screenedPairsLCS<uint16_t>(index, values, bands, bandWidth, seed, triplets); break;
+    default: screenedPairsLCS<int>(index, values, bands, bandWidth, seed, triplets);
+  }
+}
+
+/* lcs of the pairs selected by subsamplePairs, not ordered */
+void lcsTwoStagePairs(MatrixView<const int> values, const double colFraction, const size_t budget, const int seed, std::vector<triple> &triplets) {
+  gPairStats = PairStats();
+  TraceStage stage("pairs");
+  vector<int> buffer;
+  MatrixView<const int> index = sortedIndex(values, buffer);
+  switch (indexBytes(index.ncol())) {
+    case 1: twoStagePairsLCS<uint8_t>(index, values, colFraction, budget, seed, triplets); break;
+    case 2: twoStagePairsLCS<uint16_t>(index, values, colFraction, budget, seed, triplets); break;
+    default: twoStagePairsLCS<int>(index, values, colFraction, budget, seed, triplets);
+  }
+}
+
+/* biclusters for every setting from the seeds ordered by lcs, the blocks in outputs are owned by the caller,
+   sinks are either empty or hold a sink (or NULL) for every setting */
+void clusterSettings(std::vector<Params> &settings, MatrixView<const int> index, MatrixView<const int> values, std::vector<triple> const &seeds,
+  const int rowNumber, const int colNumber, std::vector<std::vector<BicBlock*>> &outputs, std::vector<ClusterStats> &stats,
+  std::vector<BlockSink*> const &sinks) {
+  TraceStage stage("cluster");
+  vector<uint64_t> nonzeroMask;
+  nonzeroMasks(values, rowNumber, colNumber, nonzeroMask);
+  switch (indexBytes(index.ncol())) {
+    case 1: clusterMatrix<uint8_t>(settings, index, values, nonzeroMask, seeds, rowNumber, colNumber, outputs, stats, sinks); break;
+    case 2: clusterMatrix<uint16_t>(settings, index, values, nonzeroMask, seeds, rowNumber, colNumber, outputs, stats, sinks); break;
+    default: clusterMatrix<int>(settings, index, values, nonzeroMask, seeds, rowNumber, colNumber, outputs, stats, sinks);
+  }
+}
+
+/* nonzeroMasks of a sparse matrix */
+static void nonzeroMasks(SparseRowMatrix const &m, std::vector<uint64_t> &nonzeroMask) {
+  const int maskWords = (m.NCol + 63) / 64;
+  nonzeroMask.assign(static_cast<size_t>(m.NRow) * maskWords, 0);
+  for (auto i = 0; i < m.NRow; i++) {
+    uint64_t *mask = nonzeroMask.data() + static_cast<size_t>(i) * maskWords;
+    if (m.Background[i] != 0)
+      for (auto j = 0; j < m.NCol; j++)
+        mask[j / 64] |= static_cast<uint64_t>(1) << (j % 64);
+    for (auto k = m.Offsets[i]; k < m.Offsets[i+1]; k++) {
+      if (m.Values[k] != 0)
+        mask[m.Cols[k] / 64] |= static_cast<uint64_t>(1) << (m.Cols[k] % 64);
+      else
+        mask[m.Cols[k] / 64] &= ~(static_cast<uint64_t>(1) << (m.Cols[k] % 64));
+    }
+  }
+}
+
+/* clusterSettings for a sparse matrix */
+void clusterSettings(std::vector<Params> &settings, SparseRowMatrix const &m, std::vector<triple> const &seeds,
+  std::vector<std::vector<BicBlock*>> &outputs, std::vector<ClusterStats> &stats, std::vector<BlockSink*> const &sinks) {
+  TraceStage stage("cluster");
+  vector<uint64_t> nonzeroMask;
+  nonzeroMasks(m, nonzeroMask);
+  switch (indexBytes(m.NCol)) {
+    case 1: clusterSparse<uint8_t>(settings, m, nonzeroMask, seeds, outputs, stats, sinks); break;
+    case 2: clusterSparse<uint16_t>(settings, m, nonzeroMask, seeds, outputs, stats, sinks); break;
+    default: clusterSparse<int>(settings, m, nonzeroMask, seeds, outputs, stats, sinks);
+  }
+}
+
+/* bit masks of nonzero values of each row, used to prefilter the reverse order candidates */
+void nonzeroMasks(MatrixView<const int> discreteInputValues, const int rowNumber, const int colNumber, std::vector<uint64_t> &nonzeroMask) {
+  const int maskWords = (colNumber + 63) / 64;
+  nonzeroMask.assign(static_cast<size_t>(rowNumber) * maskWords, 0);
+  for (auto i = 0; i < rowNumber; i++) {
+    for (auto j = 0; j < colNumber; j++) {
+      if (discreteInputValues(i, j) != 0)
+        nonzeroMask[static_cast<size_t>(i) * maskWords + j / 64] |= static_cast<uint64_t>(1) << (j % 64);
+    }
+  }
+}
+
+/* pairCache if the lcs with pattern costs more than a lookup, otherwise NULL */
+template<typename T>
+static PairTagCache<T> *worthCaching(PairTagCache<T> *pairCache, LcsPattern<T> const &pattern) {
+  size_t words = (pattern.size() + 63) / 64;
+  return pattern.size() * words >= PAIR_TAG_MIN_WORK ? pairCache : NULL;
+}
+
+/* appends the tags of the lcs of pattern and row to out, from pairCache when key was seen before */
+template<typename T>
+static void pairTags(PairTagCache<T> *pairCache, PairTagKey const &key, LcsPattern<T> const &pattern, RowSpan<T> row,
+  std::vector<T> &out, LcsWorkspace<T> &workspace, long &hits, long &misses) {
+  if (pairCache == NULL) {
+    pattern.tags(row, out, workspace);
+    return;
+  }
+  if (pairCache->find(key, out)) {
+    #pragma omp atomic
+    hits++;
+    return;
+  }
+  size_t start = out.size();
+  pattern.tags(row, out, workspace);
+  pairCache->insert(key, RowSpan<T>(out.data() + start, out.size() - start));
+  #pragma omp atomic
+  misses++;
+}
+
+/* seed loop and post-processing of cluster for the given parameters
+   the filtered blocks are returned in output and owned by the caller */
+template<typename T>
+void internalCluster(Params *params, RowSet<T> const &discreteInputData, std::vector<uint64_t> const &nonzeroMask, std::vector<triple> const &seeds,
+  const int rowNumber, const int colNumber, std::vector<BicBlock*> &output, SeedTagCache<T> *tagCache, PairTagCache<T> *pairCache, ClusterStats *stats, BlockSink *sink) {
+
+  const int maskWords = (colNumber + 63) / 64;
+  // vector of found bicluster and current bicluster candidate
+  vector<BicBlock*> arrBlocks;
+  BicBlock *currBlock;
+  // a rejected block is reused by the next seed
+  BicBlock *spareBlock = NULL;
+
+  // helpful vectors/sets
+  vector<int> vecBicGenes;
+  set<int> vecAllInCluster;
+
+  // buffers of the seed loop reused by every seed
+  SeedArena<T> arena;
+  long expanded = 0, tagHits = 0, tagMisses = 0;
+  RowSet<T> &temptag = arena.TempTags, &reveTag = arena.ReveTags;
+
+  //Main loop
+  for(size_t ind = 0; ind < seeds.size(); ind++) {
+    int seedOne = seeds[ind].geneA, seedTwo = seeds[ind].geneB, seedScore = seeds[ind].lcslen;
+
+    /* check if both genes already enumerated in previous blocks */
+    bool flag = true;
+    /* speed up the program if the rows bigger than 200 */
+    if (rowNumber > 250) {
+      if ( vecAllInCluster.find(seedOne) != vecAllInCluster.end() && vecAllInCluster.find(seedTwo) != vecAllInCluster.end())
+        flag = false;
+    }
+    else {
+      flag = check_seed(seedScore, seedOne, seedTwo, arrBlocks, arrBlocks.size(), rowNumber);
+    }
+    if (!flag)  {
+      continue;
+    }
+    arena.reset();
+    expanded++;
+    TraceSpan seedSpan("seed", "seed", ind);
+
+    // Init Current block
+    if (spareBlock != NULL) {
+      currBlock = spareBlock;
+      spareBlock = NULL;
+      currBlock->genes.clear();
+      currBlock->conds.clear();
+      currBlock->block_rows = currBlock->block_cols = currBlock->block_rows_pre = currBlock->cond_low_bound = 0;
+      currBlock->significance = 0;
+    }
+    else
+      currBlock = new BicBlock();
+    currBlock->score = min(2, seedScore);
+    currBlock->pvalue = 1;
+    // vectors with current genes and scores
+    vector<int> &vecGenes = arena.Genes, &vecScores = arena.Scores;
+
+    // init the vectors
+    vecGenes.reserve(rowNumber);
+    vecScores.reserve(rowNumber);
+    vecGenes.push_back(seedOne);
+    vecGenes.push_back(seedTwo);
+    vecScores.push_back(1);
+    vecScores.push_back(currBlock->score);
+
+    //set threshold for new candidates for bicluster
+    int candThreshold = static_cast<int>(floor(params->ColWidth * params->Tolerance));
+    if (candThreshold < 2) 
+      candThreshold = 2;
+
+    // vector for candidate rows and their pvalues	
+    vector<bool> &candidates = arena.Candidates;
+    vector<long double> &pvalues = arena.Pvalues;
+    candidates.assign(rowNumber, true);
+
+    // init the vectors
+    pvalues.reserve(rowNumber);
+    candidates[seedOne] = candidates[seedTwo] = false;
+
+    // initial components before block init
+    int components = 2;
+
+    // lcs of the seed with all rows, shared between settings of a sweep
+    std::shared_ptr<const RowSet<T>> seedTags;
+    if (tagCache != NULL) {
+      seedTags = tagCache->find(seedOne, seedTwo);
+      if (!seedTags) {
+        std::shared_ptr<RowSet<T>> newTags = std::make_shared<RowSet<T>>();
+        block_tags(seedOne, seedTwo, *newTags, &discreteInputData, params, &arena.Threads);
+        tagCache->insert(seedOne, seedTwo, newTags);
+        seedTags = newTags;
+      }
+    }
+    else
+      block_tags(seedOne, seedTwo, arena.Tags, &discreteInputData, params, &arena.Threads);
+    const RowSet<T> &lcsTags = tagCache != NULL ? *seedTags : arena.Tags;
+
+    block_init(seedTwo, currBlock, vecGenes, vecScores, candidates, candThreshold, &components, pvalues, params, lcsTags);
+    
+    // check new components
+    std::size_t  k=0;
+    for(k = 0; k < components; k++) {
+      if (params->IsPValue)
+        if ((pvalues[k] == currBlock->pvalue) &&(k >= 2) &&(vecScores[k]!=vecScores[k+1])) 
+          break;
+      if ((vecScores[k] == currBlock->score)&&(vecScores[k+1]!= currBlock->score)) 
+        break;
+    }
+ 
+    components = k + 1;
+    if(components > vecGenes.size())
+      components = vecGenes.size();
+    vecGenes.resize(components);
+    
+    // reinitialize candidates vector for further searching
+    fill(candidates.begin(), candidates.end(), true);
+    for (auto ki=0; ki < vecGenes.size() ; ki++) {
+      candidates[vecGenes[ki]] = false;
+    }
+    if(k<vecGenes.size())
+      candidates[vecGenes[k]]=false;
+    // sorted column candidates
+    vector<int> &colcand = arena.ColCand;
+
+    // initialize column threshold
+    int threshold = floor(components * 0.7)-1;
+    if(threshold <1)
+      threshold=1;
+
+    //vector for column statistics
+    vector<int> &colsStat = arena.ColsStat;
+    colsStat.assign(colNumber, 0);
+
+
+    //calculate column statistics for current components
+    LcsPattern<T> &pattern = arena.Pattern;
+    // the tags of two whole rows are the same for every seed, they are looked up in pairCache first
+    pattern.assign(discreteInputData[vecGenes[0]]);
+    PairTagCache<T> *passCache = worthCaching(pairCache, pattern);
+    parallelRows(temptag, components, params->NumThreads(), [&](int i, vector<T> &out, LcsWorkspace<T> &workspace) {
+      if (i > 0)
+        pairTags(passCache, PairTagKey{vecGenes[0], vecGenes[i], 0}, pattern, discreteInputData[vecGenes[i]], out, workspace, tagHits, tagMisses);
+    }, &arena.Threads, "block lcs");
+    for(auto jt=temptag.Values.begin();jt!=temptag.Values.end();jt++){      
+        colsStat[*jt]++;
+    }
+    // insert current column candidates
+    for(auto i=0;i<colNumber;i++) {
+      if (colsStat[i] >= threshold) {
+        colcand.push_back(i);
+      }
+    }
+
+    //--------------------------------------------------------------------------------------------------------------------------------
+    // Add new genes
+
+    int countThreshold = floor(colcand.size() * params->Tolerance);
+    if(params->UseLegacy)
+      countThreshold += -1;
+ 
+    // admit rows whose lcs with the seed covers enough column candidates
+    admit_candidates(lcsTags, colcand, candidates, countThreshold, colsStat, vecGenes, components, params->NumThreads(), arena);
+    currBlock->block_rows_pre = components;
+
+    //------------------------------------------------------------------------------------------------------------------------------------------------
+    // Add new genes based on reverse order
+
+    vector<T> &g1Common = arena.G1Common;  
+    // columns of the lcs of the first two rows
+    vector<char> &revColcand = arena.RevColumns;
+    revColcand.assign(colNumber, 0);
+    for (auto it = lcsTags[vecGenes[1]].begin(); it != lcsTags[vecGenes[1]].end(); it++)
+      revColcand[*it] = 1;
+    for (auto i = 0; i < discreteInputData[vecGenes[0]].size() ;i++){
+      if(revColcand[discreteInputData[vecGenes[0]][i]])
+        g1Common.push_back(discreteInputData[vecGenes[0]][i]);
+    }
+    // rows are rejected into a byte vector, concurrent writes to vector<bool> would race
+    vector<char> &lowCommon = arena.LowCommon;
+    lowCommon.assign(rowNumber, 0);
+    const uint64_t *seedMask = &nonzeroMask[static_cast<size_t>(vecGenes[0]) * maskWords];
+    #pragma omp parallel for default(shared) num_threads(params->NumThreads())
+    for (auto ki = 0; ki < rowNumber; ki++) {
+      // number of columns in which both the seed and the candidate are nonzero
+      int commonCnt = countCommonBits(seedMask, &nonzeroMask[static_cast<size_t>(ki) * maskWords], maskWords);
+      if(commonCnt< floor(colcand.size() * params->Tolerance)) {
+        lowCommon[ki] = 1;
+      }     
+    }
+    for (auto ki = 0; ki < rowNumber; ki++) {
+      if (lowCommon[ki])
+        candidates[ki] = false;
+    }
+    // both rows are restricted to the columns of revColcand, which identify the pair in pairCache
+    pattern.assign(RowSpan<T>(g1Common));
+    passCache = worthCaching(pairCache, pattern);
+    uint64_t revFilter = passCache != NULL ? passCache->filterId(revColcand) : 0;
+    parallelRows(reveTag, rowNumber, params->NumThreads(), [&](int ki, vector<T> &out, LcsWorkspace<T> &workspace) {
+      if(!candidates[ki])
+        return;
+      PairTagKey key = {vecGenes[0], ki, revFilter};
+      if (passCache != NULL && passCache->find(key, out)) {
+        #pragma omp atomic
+        tagHits++;
+        return;
+      }
+      vector<T> &g2Common = workspace.Row;
+      g2Common.clear();
+       //instersect second lcs input with lcs seed and calculate common vector
+      for (auto i = 0; i < discreteInputData[ki].size() ;i++){
+        if(revColcand[discreteInputData[ki][i]])
+          g2Common.push_back(discreteInputData[ki][i]);
+      }
+      //reverse the second input
+      reverse(g2Common.begin(), g2Common.end());
+      //calculate the lcs
+      size_t start = out.size();
+      pattern.tags(RowSpan<T>(g2Common), out, workspace);
+      if (passCache != NULL) {
+        passCache->insert(key, RowSpan<T>(out.data() + start, out.size() - start));
+        #pragma omp atomic
+        tagMisses++;
+      }
+    }, &arena.Threads, "reverse lcs");
+    admit_candidates(reveTag, colcand, candidates, countThreshold, colsStat, vecGenes, components, params->NumThreads(), arena);
+    // save the current cluster
+    for (auto ki = 0; ki < currBlock->block_rows_pre; ki++)
+      vecBicGenes.push_back(vecGenes[ki]);
+
+    // add conditions to current bicluster
+    for (auto it = colcand.begin(); it!=colcand.end(); it++)
+        currBlock->conds.push_back(*it);
+    currBlock->block_cols = currBlock->conds.size();
+
+    // check the minimal requirements for bicluster
+    if (currBlock->block_cols < 4 || components < 5){
+      spareBlock = currBlock;
+      continue;      
+    }
+    currBlock->block_rows = components;
+
+    // update score of current bicluster
+    if (params->IsPValue)
+      currBlock->score = -(100*log(currBlock->pvalue));
+    else
+      currBlock->score = currBlock->block_rows * currBlock->block_cols;
+
+    // add genes to current bicluster
+    currBlock->genes.clear();    
+    for (auto ki=0; ki < components; ki++){
+      currBlock->genes.push_back(vecGenes[ki]);
+      // update vector with all found genes
+      auto result1 = vecAllInCluster.find(vecGenes[ki]);
+      if(result1==vecAllInCluster.end())
+        vecAllInCluster.insert(vecGenes[ki]);
+    }
+    // add current block to vector
+    arrBlocks.push_back(currBlock);
+    if (sink != NULL)
+      sink->emit(*currBlock);
+
+    // check termination condition 
+    if (arrBlocks.size() == params->SchBlock) 
+      break;
+  }
+  delete spareBlock;
+  arena.reset();
+  if (stats != NULL) {
+    stats->Seeds = expanded;
+    stats->ScratchBytes = arena.PeakBytes;
+    stats->TagHits = tagHits;
+    stats->TagMisses = tagMisses;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------------
+  // Sorting and postprocessing of biclusters
+  TraceSpan postSpan("postprocess", "blocks", arrBlocks.size());
+
+  stable_sort(arrBlocks.begin(), arrBlocks.end(), &blockComp);
+  int n = min(static_cast<int>(arrBlocks.size()), params->RptBlock);
+  bool flag;
+
+  output.clear(); // vector with filtered biclusters
+  output.reserve(n);
+  BicBlock *b_ptr;
+
+  double cur_rows, cur_cols;
+  double inter_rows, inter_cols;
+
+  /* the major post-processing here, filter overlapping blocks*/
+  int i = 0, j = 0, k=0;
+  while (i < arrBlocks.size() && j < n) {
+    b_ptr = arrBlocks[i];
+    cur_rows = b_ptr->block_rows;
+    cur_cols = b_ptr->block_cols;
+    
+    flag = true;
+    k = 0;
+    while (k < j) {
+      inter_rows =0;
+      for(auto iter = output[k]->genes.begin(); iter != output[k]->genes.end(); iter++) {
+        auto result1 = find(b_ptr->genes.begin(), b_ptr->genes.end(), *iter);
+        if(result1!=b_ptr->genes.end()){
+          inter_rows++;
+        }
+      }
+      inter_cols=0;
+      for(auto iter = output[k]->conds.begin(); iter != output[k]->conds.end(); iter++) {
+        auto result1 = find(b_ptr->conds.begin(), b_ptr->conds.end(), *iter);
+        if(result1!=b_ptr->conds.end()){
+          inter_cols++;
+        }
+      }
+      if (inter_rows*inter_cols > params->Filter*cur_rows*cur_cols) {
+        flag = false;
+        break;
+      }
+      k++;
+    }
+    i++;
+    if (flag) {
+      // print_bc(fw, b_ptr, j++); file print
+      j++;
+      output.push_back(b_ptr);
+    }
+    else
+      delete b_ptr;
+  }
+  for(auto ind = i; ind<arrBlocks.size(); ind++)
+      delete arrBlocks[ind];
+}
@@ -0,0 +1,115 @@
+/***
+Copyright (c) 2017 Patryk Orzechowski, Artur Pańszczyk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+***/
+
+/* interface of the algorithm without a dependency on R,
+   used by the Rcpp exports of runibic.cpp and by the command-line program in inst/cli */
+
+#ifndef UNIBIC_H
+#define UNIBIC_H
+
+#include <vector>
+#include <string>
+#include "GlobalDefs.h"
+
+extern Params gParameters;
+
+/* sizes in bytes of the buffers of each stage, estimated by estimateMemory or measured in gPeakMemory */
+struct StageMemory {
+  size_t Input; // discrete values, index matrix and row sequences
+  size_t Pairs; // scored and selected pairs of calculateLCS
+  size_t Cluster; // seeds, masks, buffers and caches of the seed loop
+  size_t Output; // biclusters of every setting
+  size_t TagCache; // caches of a parameter sweep, included in Cluster
+  size_t PairCache;
+  bool StreamPairs; // pairs are scored in chunks of PairChunk
+  size_t PairChunk; // at most PAIR_CHUNK, less if the pairs kept leave less of MaxMemory
+  StageMemory(): Input(0), Pairs(0), Cluster(0), Output(0), TagCache(0), PairCache(0), StreamPairs(false), PairChunk(0) {};
+};
+
+// measured by the last run of every stage
+extern StageMemory gPeakMemory;
+// work of the lcs of the last pair stage
+extern PairStats gPairStats;
+
+/* discrete matrix stored row by row, transposed once and shared by the stages which read rows,
+   Index holds the index matrix of sortRowIndices once it is needed */
+struct RowMajorMatrix {
+  int NRow;
+  int NCol;
+  std::vector<int> Values;
+  std::vector<int> Index;
+  double IndexQuantile;
+  RowMajorMatrix(): NRow(0), NCol(0), IndexQuantile(0) {};
+
+  MatrixView<const int> values() const { return MatrixView<const int>(Values.data(), NRow, NCol, true); }
+};
+
+/* numeric matrix in compressed sparse column form, as the slots p, i and x of a dgCMatrix */
+struct SparseColumnView {
+  int NRow;
+  int NCol;
+  const int *ColStart; // entries of column j are [ColStart[j], ColStart[j+1])
+  const int *Rows;
+  const double *Values;
+  SparseColumnView(int nrow, int ncol, const int *colStart, const int *rows, const double *values):
+    NRow(nrow), NCol(ncol), ColStart(colStart), Rows(rows), Values(values) {};
+};
+
+/* discrete matrix of a sparse input stored row by row: the discrete values of the stored entries
+   and, for every row, the discrete value of its zeros which are not stored */
+struct SparseRowMatrix {
+  int NRow;
+  int NCol;
+  std::vector<size_t> Offsets; // entries of row i are [Offsets[i], Offsets[i+1]), columns ascending
+  std::vector<int> Cols;
+  std::vector<int> Values;
+  std::vector<int> Background;
+  SparseRowMatrix(): NRow(0), NCol(0) {};
+
+  size_t entries() const { return Cols.size(); }
+  size_t bytes() const { return vectorBytes(Offsets) + vectorBytes(Cols) + vectorBytes(Values) + vectorBytes(Background); }
+};
+
+StageMemory estimateMemory(const int nrow, const int ncol, Params const &params, bool useFib, const int settings = 1);
+StageMemory estimateMemory(SparseRowMatrix const &m, Params const &params, bool useFib, const int settings = 1);
+std::string memoryError(const char *stage, size_t bytes, Params const &params);
+void discretizeMatrix(MatrixView<const double> x, MatrixView<int> y);
+void discretizeSparse(SparseColumnView x, SparseRowMatrix &y);
+void sortRowIndices(MatrixView<const int> x, MatrixView<int> y);
+void rowMajorMatrix(MatrixView<const int> values, RowMajorMatrix &m);
+MatrixView<const int> rowMajorIndex(RowMajorMatrix &m);
+bool lcsAllPairs(MatrixView<const int> values, bool useFib, std::vector<triple> &out, std::string &cachePath,
+  MatrixView<const int> const *index = NULL);
+bool lcsAllPairs(SparseRowMatrix const &m, bool useFib, std::vector<triple> &out, std::string &cachePath);
+void lcsNewPairs(MatrixView<const int> values, const int firstNew, std::vector<triple> const &previous, std::vector<triple> &out, bool useFib);
+void lcsScorePairs(MatrixView<const int> values, std::vector<triple> &triplets);
+void lcsPairRange(MatrixView<const int> values, const size_t first, const size_t last, const int minLength, std::vector<triple> &out);
+void lcsScreenedPairs(MatrixView<const int> values, const int bands, const int bandWidth, const int seed, std::vector<triple> &triplets);
+void lcsTwoStagePairs(MatrixView<const int> values, const double colFraction, const size_t budget, const int seed, std::vector<triple> &triplets);
+void clusterSettings(std::vector<Params> &settings, MatrixView<const int> index, MatrixView<const int> values, std::vector<triple> const &seeds,
+  const int rowNumber, const int colNumber, std::vector<std::vector<BicBlock*>> &outputs, std::vector<ClusterStats> &stats,
+  std::vector<BlockSink*> const &sinks = std::vector<BlockSink*>());
+void clusterSettings(std::vector<Params> &settings, SparseRowMatrix const &m, std::vector<triple> const &seeds,
+  std::vector<std::vector<BicBlock*>> &outputs, std::vector<ClusterStats> &stats,
+  std::vector<BlockSink*> const &sinks = std::vector<BlockSink*>());
+
+#endif
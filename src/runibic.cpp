@@ -31,12 +31,82 @@ SOFTWARE.
 #include <set>
 #include <iterator>
 #include <functional>
+#include <cmath>
 #include "GlobalDefs.h"
+#include "LCSCache.h"
+#include "Unibic.h"
+#include "BlockStream.h"
 
 using namespace std;
 using namespace Rcpp;
 
-Params gParameters;
+Rcpp::List lcsToList(std::vector<triple> const &out);
+void seedsFromVectors(Rcpp::IntegerVector scores, Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, std::vector<triple> &seeds);
+Rcpp::List fromBlocks(BicBlock ** blocks, const int numBlocks, const int nr, const int nc, Rcpp::List info);
+Rcpp::List statsToList(ClusterStats const &stats, bool cached);
+Rcpp::List memoryToList(StageMemory const &memory);
+size_t resultBytes(const int numBlocks, const int nr, const int nc);
+
+/* view of an R matrix used by the functions of Unibic.h */
+static MatrixView<const int> matrixView(Rcpp::IntegerMatrix x) {
+  return MatrixView<const int>(x.begin(), x.nrow(), x.ncol());
+}
+
+/* the matrix prepared by runiMatrix or NULL if x is an R matrix */
+static RowMajorMatrix *nativeMatrix(SEXP x) {
+  if (TYPEOF(x) != EXTPTRSXP)
+    return NULL;
+  if (Rf_inherits(x, "runiSparseMatrix"))
+    Rcpp::stop("a matrix prepared by runiSparseMatrix is only accepted by calculateLCS, cluster and clusterSweep");
+  if (!Rf_inherits(x, "runiMatrix"))
+    Rcpp::stop("expected an integer matrix or a matrix prepared by runiMatrix");
+  Rcpp::XPtr<RowMajorMatrix> m(x);
+  if (m.get() == NULL)
+    Rcpp::stop("the matrix prepared by runiMatrix is no longer valid, it has to be prepared again");
+  return m.get();
+}
+
+/* the sparse matrix prepared by runiSparseMatrix or NULL for any other input */
+static SparseRowMatrix *sparseMatrix(SEXP x) {
+  if (TYPEOF(x) != EXTPTRSXP || !Rf_inherits(x, "runiSparseMatrix"))
+    return NULL;
+  Rcpp::XPtr<SparseRowMatrix> m(x);
+  if (m.get() == NULL)
+    Rcpp::stop("the matrix prepared by runiSparseMatrix is no longer valid, it has to be prepared again");
+  return m.get();
+}
+
+/* values of an R matrix or of a prepared matrix, an R matrix of other type than integer is converted into holder */
+static MatrixView<const int> valuesView(SEXP x, Rcpp::IntegerMatrix &holder) {
+  RowMajorMatrix *m = nativeMatrix(x);
+  if (m != NULL)
+    return m->values();
+  holder = Rcpp::IntegerMatrix(x);
+  return matrixView(holder);
+}
+
+/* as valuesView, for a prepared matrix its index matrix of unisort is returned */
+static MatrixView<const int> indexView(SEXP x, Rcpp::IntegerMatrix &holder) {
+  RowMajorMatrix *m = nativeMatrix(x);
+  if (m != NULL)
+    return rowMajorIndex(*m);
+  holder = Rcpp::IntegerMatrix(x);
+  return matrixView(holder);
+}
+
+/* the parameters as set by set_runibic_params, InitOptions adapts gParameters to every matrix */
+struct SetParameters {
+  Params Values;
+  std::string TracePath;
+};
+static SetParameters gSetParameters;
+
+/* stops before a stage whose buffers need more than maxMemory */
+static void checkMemory(const char *stage, size_t bytes) {
+  std::string message = memoryError(stage, bytes, gParameters);
+  if (!message.empty())
+    Rcpp::stop(message);
+}
 
 // [[Rcpp::plugins(cpp11)]]
 // Enable OpenMP (exclude macOS)
@@ -54,15 +124,32 @@ Params gParameters;
 //' @param nbic maximum number of biclusters in output
 //' @param div number of ranks as which we treat the up(down)-regulated value: default: 0==ncol(x)
 //' @param useLegacy boolean value for legacy parameters management
+//' @param nthreads number of threads used by all stages of the algorithm,
+//' default 0 (keep the current OpenMP setting, e.g. OMP_NUM_THREADS)
+//' @param cacheDir an existing directory in which results of \code{\link{calculateLCS}}
+//' are stored and reused by later runs, default "" (no cache)
+//' @param maxMemory memory in megabytes available to each stage, default 0 (no limit);
+//' stages whose estimated buffers do not fit stop with an error before they start,
+//' and the strategies of the stages are chosen to fit, see \code{\link{memoryEstimate}}
+//' @param tracePath file to which spans of the stages, seeds and threads are written
+//' as Chrome Trace Event JSON (chrome://tracing or Perfetto), default "" (no trace);
+//' spans are added to the file until another file is set
 //' @return NULL (an empty value)
 //'
-//' @seealso \code{\link{runibic}}
+//' @seealso \code{\link{runibic}} \code{\link{get_runibic_params}}
 //' @examples
 //' set_runibic_params(0.85, 0, 1, 100, 0, FALSE)
+//' set_runibic_params(0.85, 0, 1, 100, 0, FALSE, nthreads = 2)
+//' set_runibic_params(cacheDir = tempdir())
+//' set_runibic_params(maxMemory = 4096)
+//' set_runibic_params(tracePath = file.path(tempdir(), "runibic-trace.json"))
+//' set_runibic_params()
 //'
 // [[Rcpp::export]]
-void set_runibic_params(double t = 0.85, double q = 0, double f = 1, int nbic = 100, int div = 0, bool useLegacy = false)
+void set_runibic_params(double t = 0.85, double q = 0, double f = 1, int nbic = 100, int div = 0, bool useLegacy = false, int nthreads = 0, std::string cacheDir = "",
+  double maxMemory = 0, std::string tracePath = "")
 {
+  gSetParameters = SetParameters();
   gParameters.Tolerance=t;
   gParameters.Quantile = q;
   gParameters.Filter = f;
@@ -70,6 +157,44 @@ void set_runibic_params(double t = 0.85, double q = 0, double f = 1, int nbic =
   gParameters.SchBlock = 2*gParameters.RptBlock;
   gParameters.Divided = div;
   gParameters.UseLegacy = useLegacy;
+  gParameters.Threads = nthreads;
+  gParameters.CacheDir = cacheDir;
+  gParameters.MaxMemory = static_cast<size_t>(maxMemory * 1048576);
+  if (!gTrace.start(tracePath))
+    Rcpp::stop("could not write the trace file " + tracePath);
+  gSetParameters.Values = gParameters;
+  gSetParameters.TracePath = tracePath;
+}
+
+//' Get the parameters for runibic algorithm
+//'
+//' This function returns the parameters as they were last set by
+//' \code{\link{set_runibic_params}}, before the stages adapt them to a matrix,
+//' e.g. 'div' and 'q' with their defaults. The list can be passed back with
+//' \code{do.call(set_runibic_params, params)} to restore them.
+//'
+//' @return a list with the arguments of \code{\link{set_runibic_params}}
+//'
+//' @seealso \code{\link{set_runibic_params}}
+//' @examples
+//' params <- get_runibic_params()
+//' set_runibic_params(0.95, nthreads = 1)
+//' do.call(set_runibic_params, params)
+//'
+// [[Rcpp::export]]
+Rcpp::List get_runibic_params() {
+  Params const &p = gSetParameters.Values;
+  return List::create(
+           Named("t") = p.Tolerance,
+           Named("q") = p.Quantile,
+           Named("f") = p.Filter,
+           Named("nbic") = p.RptBlock,
+           Named("div") = p.Divided,
+           Named("useLegacy") = p.UseLegacy,
+           Named("nthreads") = p.Threads,
+           Named("cacheDir") = p.CacheDir,
+           Named("maxMemory") = p.MaxMemory / 1048576.0,
+           Named("tracePath") = gSetParameters.TracePath);
 }
 
 
@@ -97,61 +222,7 @@ void set_runibic_params(double t = 0.85, double q = 0, double f = 1, int nbic =
 // [[Rcpp::export]]
 Rcpp::IntegerMatrix runiDiscretize(Rcpp::NumericMatrix x) {
   IntegerMatrix y(x.nrow(),x.ncol());
-
-  gParameters.InitOptions(x.nrow(),x.ncol());
-
-  if(gParameters.Quantile >=0.5){
-    for(auto iRow = 0; iRow < x.nrow(); iRow++){
-      NumericVector rowData = x(iRow,_);
-      rowData.sort();
-
-      for(auto iCol = 0; iCol < x.ncol(); iCol++){
-        double dSpace = 1.0 / gParameters.Divided;
-        for(auto ind=0; ind < gParameters.Divided; ind++){
-          if(x(iRow,iCol) >= calculateQuantile(rowData, x.ncol(), 1.0 - dSpace * (ind+1))){
-            y(iRow,iCol) = ind+1;
-            break;
-          }
-        }
-      }
-    }
-  }
-  else{
-    for(auto iRow = 0; iRow < x.nrow(); iRow++){
-      NumericVector rowData = x(iRow,_);
-      stable_sort(rowData.begin(), rowData.end());
-
-      double partOne = calculateQuantile(rowData,x.ncol(),1-gParameters.Quantile);
-      double partTwo = calculateQuantile(rowData,x.ncol(),gParameters.Quantile);
-      double partThree = calculateQuantile(rowData, x.ncol(), 0.5);
-      double upperLimit, lowerLimit;
-
-      if((partOne-partThree) >= (partThree - partTwo)){
-        upperLimit = 2*partThree - partTwo;
-        lowerLimit = partTwo;
-      }
-      else{
-        upperLimit = partOne;
-        lowerLimit = 2*partThree - partOne;
-      }
-      NumericVector upperPart, lowerPart;
-      upperPart = rowData[rowData > upperLimit];
-      lowerPart = rowData[rowData < lowerLimit];
-      for(auto iCol = 0; iCol < x.ncol(); iCol++){
-        double dSpace = 1.0 / gParameters.Divided;
-        for(auto ind=0; ind < gParameters.Divided; ind++){
-          if(lowerPart.size() > 0 && x(iRow,iCol) <= calculateQuantile(lowerPart, lowerPart.size(), dSpace * (ind+1))){
-            y(iRow,iCol) = -ind-1;
-            break;
-          }
-          if(upperPart.size() > 0 && x(iRow,iCol) >= calculateQuantile(upperPart, upperPart.size(), 1.0 - dSpace * (ind+1))){
-            y(iRow,iCol) = ind+1;
-            break;
-          }
-        }
-      }
-    }
-  }
+  discretizeMatrix(MatrixView<const double>(x.begin(), x.nrow(), x.ncol()), MatrixView<int>(y.begin(), y.nrow(), y.ncol()));
   return y;
 }
 //' Computing the indexes of j-th smallest values of each row
@@ -167,44 +238,101 @@ Rcpp::IntegerMatrix runiDiscretize(Rcpp::NumericMatrix x) {
 //' @examples
 //' A <- matrix(c(4, 3, 1, 2, 5, 8, 6, 7), nrow=2, byrow=TRUE)
 //' unisort(A)
-//' @seealso \code{\link{runibic}} \code{\link{calculateLCS}} \code{\link{runiDiscretize}}
+//' unisort(runiMatrix(A))
+//' @seealso \code{\link{runibic}} \code{\link{calculateLCS}} \code{\link{runiDiscretize}} \code{\link{runiMatrix}}
 //'
 //' @export
 // [[Rcpp::export]]
-Rcpp::IntegerMatrix unisort(Rcpp::IntegerMatrix x) {
-  int nr = x.nrow();
-  int nc = x.ncol();
-  gParameters.InitOptions(nr,nc);
-  IntegerMatrix y(nr,nc);
-  int max=omp_get_max_threads();
-  omp_set_num_threads(max);
-
-  vector< pair<int,int> > a;
-  #pragma omp parallel for private(a)
-  for (auto  j=0; j<nr; j++) {
-    for (auto  i=0; i<nc; i++) {
-      a.push_back(std::make_pair(x(j,i),i));
-    }
-
-    stable_sort(a.begin(), a.end());
-    if(gParameters.Quantile < 0.5){
-      int ind=0;
-      for (auto  i=0; i<nc; i++) {
-        if(a[i].first == 0){
-          ind = i;
-          break;
-        }
-      } 
-      rotate(a.begin(), a.begin()+ind+1,a.end());
-    }
-    for (auto  i=0; i<nc; i++) {
-      y(j,i)=a[i].second;
-    }
-    a.clear();
+Rcpp::IntegerMatrix unisort(SEXP x) {
+  RowMajorMatrix *m = nativeMatrix(x);
+  if (m != NULL) {
+    MatrixView<const int> index = rowMajorIndex(*m);
+    IntegerMatrix y(m->NRow, m->NCol);
+    for (auto i = 0; i < m->NRow; i++)
+      for (auto j = 0; j < m->NCol; j++)
+        y(i, j) = index(i, j);
+    return y;
   }
+  IntegerMatrix values(x);
+  IntegerMatrix y(values.nrow(), values.ncol());
+  sortRowIndices(matrixView(values), MatrixView<int>(y.begin(), y.nrow(), y.ncol()));
   return y;
 }
 
+//' Prepare a discrete matrix shared by the steps of the algorithm
+//'
+//' This function copies an integer matrix once into a row by row layout
+//' in native memory, which is read directly by \code{\link{unisort}},
+//' \code{\link{calculateLCS}}, \code{\link{cluster}} and \code{\link{clusterSweep}}
+//' in place of the matrix. Each step reads the rows of the input, so no step
+//' has to copy the matrix or read it column by column. The indices of sorted
+//' columns of \code{\link{unisort}} are calculated once and kept with the matrix.
+//' The returned object is an external pointer; it is not kept when the R session is saved.
+//'
+//' @param discreteInput an integer matrix, usually from \code{\link{runiDiscretize}}
+//' @return an external pointer of class 'runiMatrix'
+//'
+//' @examples
+//' A <- matrix(c(4, 3, 1, 2, 5, 8, 6, 7, 9, 10, 11, 12), nrow=4, byrow=TRUE)
+//' m <- runiMatrix(A)
+//' lcsResults <- calculateLCS(m)
+//' cluster(m, m, lcsResults$lcslen, lcsResults$a, lcsResults$b, nrow(A), ncol(A))
+//' @seealso \code{\link{runibic}} \code{\link{unisort}} \code{\link{calculateLCS}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+SEXP runiMatrix(Rcpp::IntegerMatrix discreteInput) {
+  RowMajorMatrix *m = new RowMajorMatrix();
+  rowMajorMatrix(matrixView(discreteInput), *m);
+  Rcpp::XPtr<RowMajorMatrix> ptr(m, true);
+  ptr.attr("class") = "runiMatrix";
+  return ptr;
+}
+
+//' Prepare a sparse matrix shared by the steps of the algorithm
+//'
+//' This function discretizes a sparse matrix of class 'dgCMatrix' (package Matrix)
+//' as \code{\link{runiDiscretize}} with the parameters set by \code{\link{set_runibic_params}}
+//' and keeps it in native memory for \code{\link{calculateLCS}}, \code{\link{cluster}}
+//' and \code{\link{clusterSweep}}, which give the same results as for the dense matrix.
+//' The matrix is never made dense: the levels of every row are calculated from its
+//' stored values and the number of its zeros, which share one level, and the rows
+//' sequences of the other steps are built from the stored values. With q < 0.5, where
+//' the zeros of a sparse row usually get level zero, the sequences keep only the
+//' columns with nonzero levels, so memory and time follow the number of stored values.
+//' The returned object is an external pointer; it is not kept when the R session is saved.
+//'
+//' @param x a sparse numeric matrix of class 'dgCMatrix'
+//' @return an external pointer of class 'runiSparseMatrix' with the dimensions of x in attribute 'Dim'
+//'
+//' @examples
+//' if (requireNamespace("Matrix", quietly = TRUE)) {
+//'   A <- Matrix::rsparsematrix(200, 50, density = 0.1)
+//'   set_runibic_params(q = 0.1)
+//'   m <- runiSparseMatrix(A)
+//'   lcsResults <- calculateLCS(m)
+//'   cluster(m, m, lcsResults$lcslen, lcsResults$a, lcsResults$b, nrow(A), ncol(A))
+//'   set_runibic_params()
+//' }
+//' @seealso \code{\link{runibic}} \code{\link{runiMatrix}} \code{\link{calculateLCS}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+SEXP runiSparseMatrix(Rcpp::S4 x) {
+  if (!x.is("dgCMatrix"))
+    Rcpp::stop("expected a sparse matrix of class dgCMatrix");
+  Rcpp::IntegerVector dim = x.slot("Dim");
+  Rcpp::IntegerVector colStart = x.slot("p");
+  Rcpp::IntegerVector rows = x.slot("i");
+  Rcpp::NumericVector values = x.slot("x");
+  SparseRowMatrix *m = new SparseRowMatrix();
+  discretizeSparse(SparseColumnView(dim[0], dim[1], colStart.begin(), rows.begin(), values.begin()), *m);
+  Rcpp::XPtr<SparseRowMatrix> ptr(m, true);
+  ptr.attr("class") = "runiSparseMatrix";
+  ptr.attr("Dim") = dim;
+  return ptr;
+}
+
 
 
 //' Calculate a matrix of Longest Common Subsequence (LCS) 
@@ -305,8 +433,13 @@ Rcpp::IntegerVector backtrackLCS(Rcpp::IntegerVector x, Rcpp::IntegerVector y) {
 //' The function uses two different sorting methods. The default one 
 //' uses Fibonacci Heap used in original implementation of Unibic, 
 //' the second one uses standard sorting algorithm from C++ STL.
+//' If 'cacheDir' was set by \code{\link{set_runibic_params}} the result is stored
+//' in that directory and reused for the same discrete matrix and settings.
+//' If 'maxMemory' was set and all pairs of rows do not fit in it, the pairs are
+//' scored in chunks and only the selected ones are kept, with the same result.
 //'
-//' @param discreteInput is a input discrete matrix
+//' @param discreteInput is a input discrete matrix or a matrix prepared by \code{\link{runiMatrix}}
+//' or \code{\link{runiSparseMatrix}}
 //' @param useFibHeap boolean value for choosing which sorting method 
 //' should be used in sorting of output
 //' @return a list with sorted values based on calculation of the length of LCS
@@ -319,43 +452,41 @@ Rcpp::IntegerVector backtrackLCS(Rcpp::IntegerVector x, Rcpp::IntegerVector y) {
 //'
 //' @export
 // [[Rcpp::export]]
-Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap=true) {
-
-  //Copy input data to local vector
-  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
-
-  Rcpp::IntegerMatrix discreteInputIndex = unisort(discreteInput);
-  vector<vector<int>> discreteInputData(discreteInputIndex.nrow());
-  for (auto i = 0; i < discreteInputData.size(); i++) {
-    if(gParameters.Quantile < 0.5){
-      //(*it).reserve(discreteInput.ncol());
-      for (auto j = 0; j < discreteInputIndex.ncol(); j++){
-        if(discreteInput(i, discreteInputIndex(i, j))!=0)
-          discreteInputData[i].push_back(discreteInputIndex(i, j));
-      } 
-    }
-    else{
-      discreteInputData[i].reserve(discreteInputIndex.ncol());
-      for (auto j = 0; j < discreteInputIndex.ncol(); j++){
-        discreteInputData[i].push_back(discreteInputIndex(i, j));
-      } 
-    }
-  }
-  //calculate the size of output
-  int PART = 4;
-  int step = discreteInputIndex.nrow()/PART;
-  int size = (PART-1)*(step*(step-1)/2);
-  int rest = step+(discreteInputIndex.nrow()%PART);
-  size+= rest*(rest-1)/2;
+Rcpp::List calculateLCS(SEXP discreteInput, bool useFibHeap=true) {
+  // the result of a previous run with the same input and settings is reused if cacheDir is set
   vector<triple> out;
-  out.reserve(size);
-  
-  internalCalulateLCS(discreteInputData,out, useFibHeap);
+  string cachePath;
+  bool written;
+  SparseRowMatrix *sparse = sparseMatrix(discreteInput);
+  if (sparse != NULL) {
+    StageMemory need = estimateMemory(*sparse, gParameters, useFibHeap);
+    checkMemory("pair", need.Input + need.Pairs);
+    if (!lcsAllPairs(*sparse, useFibHeap, out, cachePath))
+      Rcpp::warning("could not write the LCS cache file " + cachePath);
+    return lcsToList(out);
+  }
+  RowMajorMatrix *m = nativeMatrix(discreteInput);
+  Rcpp::IntegerMatrix holder;
+  MatrixView<const int> values = valuesView(discreteInput, holder);
+  StageMemory need = estimateMemory(values.nrow(), values.ncol(), gParameters, useFibHeap);
+  checkMemory("pair", need.Input + need.Pairs);
+  if (m != NULL) {
+    MatrixView<const int> index = rowMajorIndex(*m);
+    written = lcsAllPairs(m->values(), useFibHeap, out, cachePath, &index);
+  }
+  else
+    written = lcsAllPairs(values, useFibHeap, out, cachePath);
+  if (!written)
+    Rcpp::warning("could not write the LCS cache file " + cachePath);
+  return lcsToList(out);
+}
+
+Rcpp::List lcsToList(std::vector<triple> const &out) {
   Rcpp::IntegerVector geneA(out.size());
   Rcpp::IntegerVector geneB(out.size());
   Rcpp::IntegerVector lcslen(out.size());
    
-  for(auto i = 0; i < out.size(); i++)
+  for(size_t i = 0; i < out.size(); i++)
   {
     geneA(i) = out[i].geneA;
     geneB(i) = out[i].geneB;
@@ -372,9 +503,237 @@ Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap=true)
            Named("a") = geneA,
            Named("b") = geneB,
            Named("lcslen") = lcslen);
+}
+
+//' Update Longest Common Subsequences after adding rows to a matrix
+//'
+//' This function extends the result of \code{\link{calculateLCS}} computed
+//' for the first 'nOld' rows of a matrix with the rows appended afterwards.
+//' The result is the same as \code{\link{calculateLCS}} of the whole matrix:
+//' rows are paired within the same blocks, which move as rows are added, and the
+//' pairs are selected and sorted in the same way. The LCS of pairs of previous rows
+//' found in 'previous' is reused, the other pairs, i.e. the ones with a new row,
+//' the ones which the blocks of the smaller matrix did not pair and the ones dropped
+//' by the heap, are calculated. The output can be passed directly to \code{\link{cluster}}
+//' or to the next update. The cost of an update grows with the number of new rows only
+//' if 'previous' holds all pairs, i.e. with useFibHeap = FALSE: the heap keeps the
+//' 20 million pairs with the longest LCS, so for more than about 12600 rows the pairs
+//' of previous rows which it dropped are calculated again at every update.
+//'
+//' @param discreteInput an input discrete matrix with previous rows first
+//' followed by new rows
+//' @param previous a list returned by \code{\link{calculateLCS}} or
+//' \code{\link{updateLCS}} for the first 'nOld' rows
+//' @param nOld number of rows for which 'previous' was calculated
+//' @param useFibHeap boolean value for choosing which sorting method
+//' should be used in sorting of output
+//' @return a list with sorted values based on calculation of the length of LCS
+//' in the same format as \code{\link{calculateLCS}}
+//'
+//' @examples
+//' A <- matrix(sample(-3:3, 200, replace = TRUE), nrow = 20)
+//' lcsOld <- calculateLCS(A[1:15, ])
+//' updateLCS(A, lcsOld, 15)
+//' @seealso \code{\link{calculateLCS}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List updateLCS(Rcpp::IntegerMatrix discreteInput, Rcpp::List previous, int nOld, bool useFibHeap=true) {
+
+  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
+  if (nOld < 0 || nOld > discreteInput.nrow())
+    Rcpp::stop("nOld must be between 0 and the number of rows of discreteInput");
+
+  Rcpp::IntegerVector prevA = previous["a"];
+  Rcpp::IntegerVector prevB = previous["b"];
+  Rcpp::IntegerVector prevLen = previous["lcslen"];
+  vector<triple> prev(prevA.size());
+  for (size_t i = 0; i < prev.size(); i++) {
+    prev[i].geneA = prevA(i);
+    prev[i].geneB = prevB(i);
+    prev[i].lcslen = prevLen(i);
+  }
+
+  vector<triple> out;
+  lcsNewPairs(matrixView(discreteInput), nOld, prev, out, useFibHeap);
+  return lcsToList(out);
+}
+
+/* first pair of the shard, the same as size * shard / nShards without overflowing 64 bits */
+static size_t shardStart(size_t size, int shard, int nShards) {
+  return size / nShards * shard + size % nShards * shard / nShards;
+}
+
+//' Calculate one shard of pairwise LCS between rows
+//'
+//' The pairs of rows compared by \code{\link{calculateLCS}} are split
+//' into 'nShards' ranges of equal size. This function scores the pairs of
+//' a single range and writes them to a binary file, so the shards can be
+//' calculated by separate processes, e.g. jobs of a batch scheduler.
+//' The shard files are combined by \code{\link{mergeLCSShards}}.
+//' The parameters are taken from \code{\link{set_runibic_params}} and
+//' must be the same in every shard and in the merge.
+//'
+//' @param discreteInput a discrete matrix
+//' @param shard index of the shard (from 0 to nShards-1)
+//' @param nShards number of shards
+//' @param path name of the output file
+//' @param useFibHeap boolean value for choosing which sorting method
+//' is used when the shards are merged
+//' @return number of pairs written to the file
+//'
+//' @examples
+//' A <- matrix(c(4,3,1,2,5,8,6,7,9,10,11,12,3,1,2,4,6,5), nrow=6, byrow=TRUE)
+//' files <- file.path(tempdir(), paste0("shard", 0:1, ".bin"))
+//' for (s in 0:1)
+//'   calculateLCSShard(A, s, 2, files[s+1])
+//' mergeLCSShards(A, files)
+//'
+//' @seealso \code{\link{mergeLCSShards}} \code{\link{calculateLCS}}
+//'
+//' @export
+// [[Rcpp::export]]
+double calculateLCSShard(Rcpp::IntegerMatrix discreteInput, int shard, int nShards, std::string path, bool useFibHeap=true) {
+  if (nShards < 1 || shard < 0 || shard >= nShards)
+    Rcpp::stop("shard must be between 0 and nShards-1");
+  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
+  uint64_t key = lcsShardKey(lcsCacheKey(matrixView(discreteInput), gParameters, useFibHeap), shard, nShards);
+
+  // the heap skips pairs shorter than ColWidth, so they are not stored
+  size_t size = countPairs(discreteInput.nrow());
+  vector<triple> triplets;
+  lcsPairRange(matrixView(discreteInput), shardStart(size, shard, nShards), shardStart(size, shard + 1, nShards),
+               useFibHeap ? gParameters.ColWidth : 0, triplets);
+  if (!writePairFile(path, key, triplets))
+    Rcpp::stop("could not write the shard file " + path);
+  // a shard of a large matrix can hold more than 2^31 pairs
+  return static_cast<double>(triplets.size());
+}
+
+//' Merge shards of pairwise LCS between rows
+//'
+//' Combines the files written by \code{\link{calculateLCSShard}} for all
+//' shards of the input matrix. The result is the same as returned by
+//' \code{\link{calculateLCS}} for the whole matrix.
+//'
+//' @param discreteInput a discrete matrix used to calculate the shards
+//' @param paths names of the shard files ordered by shard index
+//' @param useFibHeap boolean value for choosing which sorting method
+//' should be used in sorting of output
+//' @return a list with sorted values based on calculation of the length of LCS
+//' in the same format as \code{\link{calculateLCS}}
+//'
+//' @examples
+//' A <- matrix(c(4,3,1,2,5,8,6,7,9,10,11,12,3,1,2,4,6,5), nrow=6, byrow=TRUE)
+//' files <- file.path(tempdir(), paste0("shard", 0:1, ".bin"))
+//' for (s in 0:1)
+//'   calculateLCSShard(A, s, 2, files[s+1])
+//' mergeLCSShards(A, files)
+//'
+//' @seealso \code{\link{calculateLCSShard}} \code{\link{calculateLCS}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List mergeLCSShards(Rcpp::IntegerMatrix discreteInput, std::vector<std::string> paths, bool useFibHeap=true) {
+  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
+  uint64_t key = lcsCacheKey(matrixView(discreteInput), gParameters, useFibHeap);
+  int nShards = paths.size();
+
+  // shards are selected in the order of pairs used by calculateLCS, so ties are ordered the same way;
+  // only one shard is held at a time besides the selected pairs
+  vector<triple> out, triplets;
+  {
+    PairSelection selection(useFibHeap, out);
+    for (auto s = 0; s < nShards; s++) {
+      triplets.clear();
+      if (!readPairFile(paths[s], lcsShardKey(key, s, nShards), triplets))
+        Rcpp::stop("the shard file " + paths[s] + " is missing or does not match the input and parameters");
+      selection.add(triplets, true);
+    }
+    selection.finish();
+  }
+  return lcsToList(out);
+}
+
+//' Calculate Longest Common Subsequences between screened pairs of rows
+//'
+//' This function is a faster approximation of \code{\link{calculateLCS}}
+//' for large matrices. Before the LCS is computed the pairs of rows are screened
+//' by banded hashing of sketches of the order of columns in each row.
+//' Every band compares the order of 'bandWidth' randomly sampled pairs of columns
+//' and only the rows that agree on all pairs of at least one band are compared.
+//' More bands increase the recall of similar pairs, wider bands reduce
+//' the number of compared pairs. The recall on a given matrix may be checked with
+//' \code{\link{screeningRecall}}.
+//'
+//' @param discreteInput a discrete matrix
+//' @param bands number of bands
+//' @param bandWidth number of pairs of columns compared in each band
+//' @param useFibHeap boolean value for choosing which sorting method
+//' should be used in sorting of output
+//' @param seed seed of the sampling of pairs of columns
+//' @return a list with sorted values based on calculation of the length of LCS
+//' in the same format as \code{\link{calculateLCS}}, restricted to the screened pairs
+//'
+//' @examples
+//' A <- matrix(c(4,3,1,2,5,8,6,7,9,10,11,12,3,1,2,4,6,5), nrow=6, byrow=TRUE)
+//' calculateLCSScreened(A, bands=4, bandWidth=2)
+//'
+//' @seealso \code{\link{calculateLCS}} \code{\link{screeningRecall}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List calculateLCSScreened(Rcpp::IntegerMatrix discreteInput, int bands=16, int bandWidth=4, bool useFibHeap=true, int seed=1) {
+  if (bands < 1 || bandWidth < 1)
+    Rcpp::stop("bands and bandWidth must be positive");
+  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
+
+  vector<triple> triplets;
+  lcsScreenedPairs(matrixView(discreteInput), bands, bandWidth, seed, triplets);
+  vector<triple> out;
+  out.reserve(triplets.size());
+  orderPairs(triplets, out, useFibHeap);
+  return lcsToList(out);
+}
 
+//' Calculate Longest Common Subsequences in two stages
+//'
+//' This function is a faster approximation of \code{\link{calculateLCS}}
+//' for matrices with many columns. First the LCS between all pairs of rows
+//' is calculated on a random subset of columns. Then only the pairs with
+//' the longest approximate LCS are rescored on all columns.
+//' The agreement of the result with \code{\link{calculateLCS}} may be checked with
+//' \code{\link{twoStageAgreement}}.
+//'
+//' @param discreteInput a discrete matrix
+//' @param colFraction fraction of the columns used in the first stage
+//' @param budget fraction of the pairs rescored on all columns
+//' @param useFibHeap boolean value for choosing which sorting method
+//' should be used in sorting of output
+//' @param seed seed of the sampling of columns
+//' @return a list with sorted values based on calculation of the length of LCS
+//' in the same format as \code{\link{calculateLCS}}, restricted to the rescored pairs
+//'
+//' @examples
+//' A <- matrix(c(4,3,1,2,5,8,6,7,9,10,11,12,3,1,2,4,6,5), nrow=6, byrow=TRUE)
+//' calculateLCSTwoStage(A, colFraction=0.5, budget=0.5)
+//'
+//' @seealso \code{\link{calculateLCS}} \code{\link{twoStageAgreement}} \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List calculateLCSTwoStage(Rcpp::IntegerMatrix discreteInput, double colFraction=0.5, double budget=0.1, bool useFibHeap=true, int seed=1) {
+  if (colFraction <= 0 || colFraction > 1 || budget <= 0 || budget > 1)
+    Rcpp::stop("colFraction and budget must be in (0, 1]");
+  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
 
-//           Named("order") = triplets);
+  size_t rescored = static_cast<size_t>(ceil(budget * countPairs(discreteInput.nrow())));
+  vector<triple> triplets;
+  lcsTwoStagePairs(matrixView(discreteInput), colFraction, rescored, seed, triplets);
+  vector<triple> out;
+  out.reserve(triplets.size());
+  orderPairs(triplets, out, useFibHeap);
+  return lcsToList(out);
 }
 
 //' Calculate biclusters from sorted list of LCS scores and row indices
@@ -388,7 +747,9 @@ Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap=true)
 //' @seealso \code{\link{runibic}} \code{\link{calculateLCS}} \code{\link{unisort}}
 //'
 //' @param discreteInput an integer matrix with indices of sorted columns
+//' or a matrix prepared by \code{\link{runiMatrix}} or \code{\link{runiSparseMatrix}}
 //' @param discreteInputValues an integer matrix with discrete values
+//' or a matrix prepared by \code{\link{runiMatrix}}, not read for a matrix prepared by \code{\link{runiSparseMatrix}}
 //' @param scores a numeric vector with LCS length
 //' @param geneOne a numeric vector with first row indexes 
 //' from pairwise LCS calculation 
@@ -396,7 +757,13 @@ Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap=true)
 //' from pairwise LCS calculation 
 //' @param rowNumber a int with number of rows in the input matrix
 //' @param colNumber a int with number of columns in the input matrix
-//' @return a list with information of found biclusters
+//' @param streamPath name of a file to which every bicluster found by the seed loop
+//' is appended as soon as it is found, before overlapping biclusters are filtered out;
+//' it can be read by \code{\link{readBiclusterStream}} also while the function runs,
+//' default "" (no file)
+//' @return a list with information of found biclusters, its element 'info' holds
+//' the number of expanded seeds ('seeds') and the peak size in bytes of the buffers
+//' of the seed loop ('scratchBytes')
 //'
 //' @examples
 //' A <- matrix( c(4,3,1,2,5,8,6,7,9,10,11,12),nrow=4,byrow=TRUE)
@@ -406,359 +773,291 @@ Rcpp::List calculateLCS(Rcpp::IntegerMatrix discreteInput, bool useFibHeap=true)
 //'
 //' @export
 // [[Rcpp::export]]
-Rcpp::List cluster(Rcpp::IntegerMatrix discreteInput, Rcpp::IntegerMatrix discreteInputValues, Rcpp::IntegerVector scores, 
-  Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber) {
+Rcpp::List cluster(SEXP discreteInput, SEXP discreteInputValues, Rcpp::IntegerVector scores, 
+  Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber, std::string streamPath = "") {
  
+  // only the dimensions of index are read for a sparse matrix
+  SparseRowMatrix *sparse = sparseMatrix(discreteInput);
+  Rcpp::IntegerMatrix indexHolder, valuesHolder;
+  MatrixView<const int> index = sparse != NULL ? MatrixView<const int>(NULL, sparse->NRow, sparse->NCol) : indexView(discreteInput, indexHolder);
+  MatrixView<const int> values = sparse != NULL ? index : valuesView(discreteInputValues, valuesHolder);
   //Initialize algorithm parameters
-  gParameters.InitOptions(discreteInput.nrow(), discreteInput.ncol());
-
-  //Copy input data to local vector
-  vector<vector<int>> discreteInputData(discreteInput.nrow()); 
-  for (auto i = 0; i < discreteInputData.size(); i++) {
-    if(gParameters.Quantile < 0.5){
-      discreteInputData[i].reserve(discreteInput.ncol());
-      for (auto j = 0; j < discreteInput.ncol(); j++){
-        if(discreteInputValues(i, discreteInput(i, j))!=0)
-          discreteInputData[i].push_back(discreteInput(i, j));
-      } 
-    }
-    else{
-      discreteInputData[i].reserve(discreteInput.ncol());
-      for (auto j = 0; j < discreteInput.ncol(); j++){
-        discreteInputData[i].push_back(discreteInput(i, j));
-      } 
-    }
+  gParameters.InitOptions(index.nrow(), index.ncol());
+  StageMemory need = sparse != NULL ? estimateMemory(*sparse, gParameters, true) : estimateMemory(index.nrow(), index.ncol(), gParameters, true);
+  checkMemory("cluster", need.Input + need.Cluster + need.Output);
+
+  vector<triple> seeds;
+  seedsFromVectors(scores, geneOne, geneTwo, seeds);
+
+  BlockFileWriter stream;
+  vector<BlockSink*> sinks;
+  if (!streamPath.empty()) {
+    if (!stream.open(streamPath))
+      Rcpp::stop("could not write the bicluster file " + streamPath);
+    sinks.push_back(&stream);
   }
+  vector<Params> settings(1, gParameters);
+  vector<vector<BicBlock*>> outputs;
+  vector<ClusterStats> stats;
+  if (sparse != NULL)
+    clusterSettings(settings, *sparse, seeds, outputs, stats, sinks);
+  else
+    clusterSettings(settings, index, values, seeds, rowNumber, colNumber, outputs, stats, sinks);
+  if (!stream.close())
+    Rcpp::warning("could not write the bicluster file " + streamPath);
+  vector<BicBlock*> &output = outputs[0];
+  List outList = fromBlocks(output.data(), output.size(), rowNumber, colNumber, statsToList(stats[0], false));
+  gPeakMemory.Output += resultBytes(output.size(), rowNumber, colNumber);
+  for(size_t ind =0; ind<output.size(); ind++)
+      delete output[ind];
 
-  int max=omp_get_max_threads();
-  omp_set_num_threads(max);
-
-  // vector of found bicluster and current bicluster candidate
-  vector<BicBlock*> arrBlocks;
-  BicBlock *currBlock;
-
-  // helpful vectors/sets
-  vector<int> vecBicGenes;
-  set<int> vecAllInCluster;
-
-  // matrix of found lcs
-  vector<vector<int>> lcsTags(rowNumber);
-  //Main loop
-  for(auto ind = 0; ind < scores.size(); ind++) {
-
-    /* check if both genes already enumerated in previous blocks */
-    bool flag = true;
-    /* speed up the program if the rows bigger than 200 */
-    if (rowNumber > 250) {
-      if ( vecAllInCluster.find(geneOne(ind)) != vecAllInCluster.end() && vecAllInCluster.find(geneTwo(ind)) != vecAllInCluster.end())
-        flag = false;
-    }
-    else {
-      flag = check_seed(scores(ind),geneOne(ind), geneTwo(ind), arrBlocks, arrBlocks.size(), rowNumber);
-    }
-    if (!flag)  {
-      continue;
-    }
-
-    // Init Current block
-    currBlock = new BicBlock();
-    currBlock->score = min(2, (int)scores(ind));
-    currBlock->pvalue = 1;
-    // vectors with current genes and scores
-    vector<int> vecGenes, vecScores;
-
-    // init the vectors
-    vecGenes.reserve(rowNumber);
-    vecScores.reserve(rowNumber);
-    vecGenes.push_back(geneOne(ind));
-    vecGenes.push_back(geneTwo(ind));
-    vecScores.push_back(1);
-    vecScores.push_back(currBlock->score);
-
-    //set threshold for new candidates for bicluster
-    int candThreshold = static_cast<int>(floor(gParameters.ColWidth * gParameters.Tolerance));
-    if (candThreshold < 2) 
-      candThreshold = 2;
-
-    // vector for candidate rows and their pvalues	
-    vector<bool> candidates(rowNumber, true);
-    vector<long double> pvalues;
-
-    // init the vectors
-    pvalues.reserve(rowNumber);
-    candidates[(int)geneOne(ind)] = candidates[(int)geneTwo(ind)] = false;
-
-    // initial components before block init
-    int components = 2;
-
-    block_init(scores(ind), geneOne(ind), geneTwo(ind), currBlock, vecGenes, vecScores, candidates, candThreshold, &components, pvalues, &gParameters, lcsTags, &discreteInputData);
-    
-    // check new components
-    std::size_t  k=0;
-    for(k = 0; k < components; k++) {
-      if (gParameters.IsPValue)
-        if ((pvalues[k] == currBlock->pvalue) &&(k >= 2) &&(vecScores[k]!=vecScores[k+1])) 
-          break;
-      if ((vecScores[k] == currBlock->score)&&(vecScores[k+1]!= currBlock->score)) 
-        break;
-    }
- 
-    components = k + 1;
-    if(components > vecGenes.size())
-      components = vecGenes.size();
-    vecGenes.resize(components);
-    
-    // reinitialize candidates vector for further searching
-    fill(candidates.begin(), candidates.end(), true);
-    for (auto ki=0; ki < vecGenes.size() ; ki++) {
-      candidates[vecGenes[ki]] = false;
-    }
-    if(k<vecGenes.size())
-      candidates[vecGenes[k]]=false;
-    // set for column candidates
-    set<size_t> colcand;
-
-    // initialize column threshold
-    int threshold = floor(components * 0.7)-1;
-    if(threshold <1)
-      threshold=1;
-
-    //vector for column statistics
-    vector<int> colsStat(colNumber,0);
+  return outList;
+}
 
+//' Calculate biclusters for a grid of parameters
+//'
+//' This function runs \code{\link{cluster}} for several settings of the
+//' parameters of the clustering stage at once. The row sequences are prepared
+//' only once and the settings are processed in parallel. The LCS of every
+//' seed with all rows does not depend on the parameters and is shared between
+//' the settings. The other parameters are taken from \code{\link{set_runibic_params}}.
+//' @seealso \code{\link{cluster}} \code{\link{runibicSweep}}
+//'
+//' @param discreteInput an integer matrix with indices of sorted columns
+//' or a matrix prepared by \code{\link{runiMatrix}} or \code{\link{runiSparseMatrix}}
+//' @param discreteInputValues an integer matrix with discrete values
+//' or a matrix prepared by \code{\link{runiMatrix}}, not read for a matrix prepared by \code{\link{runiSparseMatrix}}
+//' @param scores a numeric vector with LCS length
+//' @param geneOne a numeric vector with first row indexes 
+//' from pairwise LCS calculation 
+//' @param geneTwo a numeric vector with second row indexes 
+//' from pairwise LCS calculation 
+//' @param rowNumber a int with number of rows in the input matrix
+//' @param colNumber a int with number of columns in the input matrix
+//' @param t a numeric vector with consistency level of the block for every setting
+//' @param f a numeric vector with filtering of overlapping blocks for every setting
+//' @param nbic an integer vector with maximum number of biclusters for every setting
+//' @return a list with one element per setting, each in the format returned by \code{\link{cluster}};
+//' with several settings the element 'info' also holds the numbers of LCS of pairs of rows
+//' reused ('tagCacheHits') or computed ('tagCacheMisses') through the cache shared by the settings
+//'
+//' @examples
+//' A <- matrix( c(4,3,1,2,5,8,6,7,9,10,11,12),nrow=4,byrow=TRUE)
+//' iA <- unisort(A)
+//' lcsResults <- calculateLCS(A)
+//' clusterSweep(iA, A, lcsResults$lcslen, lcsResults$a, lcsResults$b, nrow(A), ncol(A),
+//'   c(0.85, 0.95), c(1, 1), c(100, 100))
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List clusterSweep(SEXP discreteInput, SEXP discreteInputValues, Rcpp::IntegerVector scores, 
+  Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, int rowNumber, int colNumber,
+  Rcpp::NumericVector t, Rcpp::NumericVector f, Rcpp::IntegerVector nbic) {
+
+  if (f.size() != t.size() || nbic.size() != t.size())
+    Rcpp::stop("t, f and nbic must have the same length");
+  // only the dimensions of index are read for a sparse matrix
+  SparseRowMatrix *sparse = sparseMatrix(discreteInput);
+  Rcpp::IntegerMatrix indexHolder, valuesHolder;
+  MatrixView<const int> index = sparse != NULL ? MatrixView<const int>(NULL, sparse->NRow, sparse->NCol) : indexView(discreteInput, indexHolder);
+  MatrixView<const int> values = sparse != NULL ? index : valuesView(discreteInputValues, valuesHolder);
+  gParameters.InitOptions(index.nrow(), index.ncol());
+  StageMemory need = sparse != NULL ? estimateMemory(*sparse, gParameters, true, t.size())
+                                     : estimateMemory(index.nrow(), index.ncol(), gParameters, true, t.size());
+  checkMemory("cluster", need.Input + need.Cluster + need.Output);
+
+  vector<triple> seeds;
+  seedsFromVectors(scores, geneOne, geneTwo, seeds);
+
+  // every setting runs on a single thread when several settings are processed in parallel
+  int numSettings = t.size();
+  vector<Params> settings(numSettings, gParameters);
+  for (auto i = 0; i < numSettings; i++) {
+    settings[i].Tolerance = t(i);
+    settings[i].Filter = f(i);
+    settings[i].RptBlock = nbic(i);
+    settings[i].SchBlock = 2*nbic(i);
+    if (numSettings > 1)
+      settings[i].Threads = 1;
+  }
+  vector<vector<BicBlock*>> outputs;
+  vector<ClusterStats> stats;
+  if (sparse != NULL)
+    clusterSettings(settings, *sparse, seeds, outputs, stats);
+  else
+    clusterSettings(settings, index, values, seeds, rowNumber, colNumber, outputs, stats);
+
+  List results(numSettings);
+  for (auto i = 0; i < numSettings; i++) {
+    results[i] = fromBlocks(outputs[i].data(), outputs[i].size(), rowNumber, colNumber, statsToList(stats[i], numSettings > 1));
+    gPeakMemory.Output += resultBytes(outputs[i].size(), rowNumber, colNumber);
+    for (auto ind = 0; ind < outputs[i].size(); ind++)
+      delete outputs[i][ind];
+  }
+  return results;
+}
 
-    //calculate column statistics for current components
-    vector<vector<int>> temptag(components);
-    #pragma omp parallel for default(shared)
-    for(auto i=1;i<components;i++) {
-      temptag[i] = getGenesFullLCS(discreteInputData[vecGenes[0]], discreteInputData[vecGenes[i]]);
-    }
-    for(auto i=1;i<components;i++) {
-      for(auto jt=temptag[i].begin();jt!=temptag[i].end();jt++){      
-          colsStat[*jt]++;
-      }
-    }
-    temptag.clear();
-    // insert current column candidates
-    for(auto i=0;i<colNumber;i++) {
-      if (colsStat[i] >= threshold) {
-        colcand.insert(i);
-      }
-    }
+//' Read biclusters streamed by cluster
+//'
+//' Reads the file written by \code{\link{cluster}} with the 'streamPath' argument.
+//' The biclusters are returned in the order in which they were found, before
+//' sorting and filtering of overlapping biclusters. The file may be read while
+//' it is still being written.
+//'
+//' @param path name of the file
+//' @return a list with columns of the biclusters: 'score', 'pvalue', numbers of
+//' rows 'nrows' and columns 'ncols', and 'rows' and 'cols' with the indices (starting from 1)
+//' of the rows and columns of all biclusters one after another
+//'
+//' @examples
+//' A <- matrix(replicate(100, rnorm(100)), nrow=100, byrow=TRUE)
+//' set_runibic_params()
+//' B <- runiDiscretize(A)
+//' lcsResults <- calculateLCS(B)
+//' path <- file.path(tempdir(), "biclusters.bin")
+//' res <- cluster(unisort(B), B, lcsResults$lcslen, lcsResults$a, lcsResults$b, nrow(B), ncol(B), path)
+//' blocks <- readBiclusterStream(path)
+//' split(blocks$rows, rep(seq_along(blocks$nrows), blocks$nrows))
+//'
+//' @seealso \code{\link{cluster}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List readBiclusterStream(std::string path) {
+  vector<BicBlock> blocks;
+  if (!readBlockFile(path, blocks))
+    Rcpp::stop("the bicluster file " + path + " is missing or invalid");
+  int n = blocks.size();
+  Rcpp::NumericVector score(n), pvalue(n);
+  Rcpp::IntegerVector nrows(n), ncols(n);
+  vector<int> rows, cols;
+  for (auto i = 0; i < n; i++) {
+    score[i] = blocks[i].score;
+    pvalue[i] = static_cast<double>(blocks[i].pvalue);
+    nrows[i] = blocks[i].genes.size();
+    ncols[i] = blocks[i].conds.size();
+    for (auto r : blocks[i].genes)
+      rows.push_back(r + 1);
+    for (auto c : blocks[i].conds)
+      cols.push_back(c + 1);
+  }
+  return List::create(
+           Named("score") = score,
+           Named("pvalue") = pvalue,
+           Named("nrows") = nrows,
+           Named("ncols") = ncols,
+           Named("rows") = Rcpp::IntegerVector(rows.begin(), rows.end()),
+           Named("cols") = Rcpp::IntegerVector(cols.begin(), cols.end()));
+}
 
-    //--------------------------------------------------------------------------------------------------------------------------------
-    // Add new genes
+//' Estimate the memory used by the stages of runibic
+//'
+//' Estimates the sizes of the largest buffers of every stage for a matrix
+//' of the given size and the parameters set by \code{\link{set_runibic_params}}.
+//' The estimates are upper bounds which assume that every row keeps all columns
+//' and that the biclusters span the whole matrix. With 'maxMemory' set the stages
+//' choose strategies which fit: the pairs of rows are scored in chunks if they do
+//' not fit at once and the caches of \code{\link{clusterSweep}} are reduced.
+//' The stages stop with an error if their estimate is higher than 'maxMemory'.
+//'
+//' @param rowNumber number of rows of the matrix
+//' @param colNumber number of columns of the matrix
+//' @param useFibHeap boolean value for the sorting method of \code{\link{calculateLCS}}
+//' @param settings number of settings clustered together by \code{\link{clusterSweep}}
+//' @return a list with the estimated sizes in bytes of the buffers holding the input
+//' ('input'), the pairs of \code{\link{calculateLCS}} ('pairs'), the seed loop of
+//' \code{\link{cluster}} ('cluster') and the biclusters ('output'), and 'streamPairs'
+//' which tells whether the pairs are scored in chunks
+//'
+//' @examples
+//' memoryEstimate(10000, 100)
+//' set_runibic_params(maxMemory = 512)
+//' memoryEstimate(10000, 100)
+//' set_runibic_params()
+//' @seealso \code{\link{peakMemory}} \code{\link{set_runibic_params}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List memoryEstimate(int rowNumber, int colNumber, bool useFibHeap = true, int settings = 1) {
+  return memoryToList(estimateMemory(rowNumber, colNumber, gParameters, useFibHeap, settings));
+}
 
-    bool colChose = true;
-    vector<int> m_ct(rowNumber);
-    int countThreshold = floor(colcand.size() * gParameters.Tolerance);
-    if(gParameters.UseLegacy)
-      countThreshold += -1;
- 
-    // count number of occurances of candidates in results of lcs
-    for(auto ki=0;ki < rowNumber;ki++) {
-      colChose=true;
-      if(!candidates[ki])
-        continue;
-      if(candidates[ki])
-        m_ct[ki]= count_if(lcsTags[ki].begin(), lcsTags[ki].end(), [&](int k) { return colcand.find(k) != colcand.end();});
-      //check if this candidate can be added
-      if (candidates[ki]&& (m_ct[ki] >= countThreshold)) {
-        int temp;
-        for(auto it=colcand.begin(); it != colcand.end();it++){
-          //calculate column statistics of recent candidate
-          int tmpcount = colsStat[*it];
-          if(find(lcsTags[ki].begin(), lcsTags[ki].end(), *it) != lcsTags[ki].end())
-            tmpcount++;
-          if(tmpcount < floor(components * 0.1)-1) {
-            colChose = false;
-            break;
-          }
-        } 
-        if(colChose==true) {
-          //add new gene
-          vecGenes.push_back(ki);
-          components++;
-          candidates[ki] = false;
-          //update column statistics
-          for(auto it=lcsTags[ki].begin();it!=lcsTags[ki].end();it++){      
-              colsStat[*it]++;
-          }
-        }
-      }       
-    }
-    currBlock->block_rows_pre = components;
+//' Memory used by the last runs of the stages of runibic
+//'
+//' Reports the peak sizes of the buffers of the last run of \code{\link{calculateLCS}}
+//' and of \code{\link{cluster}} or \code{\link{clusterSweep}}, measured as the
+//' capacity of the buffers of the stages, in the format of \code{\link{memoryEstimate}}.
+//' 'input' is reported by the last of the stages.
+//'
+//' @return a list with the peak sizes in bytes of the buffers of the stages
+//'
+//' @examples
+//' A <- matrix(replicate(100, rnorm(100)), nrow=100, byrow=TRUE)
+//' res <- runibic(A)
+//' peakMemory()
+//' @seealso \code{\link{memoryEstimate}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List peakMemory() {
+  return memoryToList(gPeakMemory);
+}
 
-    //------------------------------------------------------------------------------------------------------------------------------------------------
-    // Add new genes based on reverse order
+//' Work of the LCS of the last pair stage
+//'
+//' Reports how the pairs of rows of the last run of \code{\link{calculateLCS}}
+//' (or of the other functions which score pairs of rows) were computed.
+//' Pairs with a row of at most 64 columns are computed bit-parallel in one word,
+//' the other ones by dynamic programming. The threads take chunks of pairs with
+//' about the same estimated work, which matters with q < 0.5, where rows keep only
+//' their nonzero columns and their lengths vary.
+//'
+//' @return a list with the number of computed pairs ('pairs'), of the pairs computed
+//' bit-parallel ('shortPairs'), the number of cells of the dynamic programming of
+//' the other pairs ('cells') and the seconds each thread spent computing LCS ('threadBusy')
+//'
+//' @examples
+//' A <- matrix(replicate(100, rnorm(100)), nrow=100, byrow=TRUE)
+//' set_runibic_params(q = 0.3)
+//' res <- calculateLCS(runiDiscretize(A))
+//' pairStats()
+//' set_runibic_params()
+//' @seealso \code{\link{calculateLCS}} \code{\link{peakMemory}}
+//'
+//' @export
+// [[Rcpp::export]]
+Rcpp::List pairStats() {
+  return List::create(
+           Named("pairs") = static_cast<double>(gPairStats.Pairs),
+           Named("shortPairs") = static_cast<double>(gPairStats.ShortPairs),
+           Named("cells") = static_cast<double>(gPairStats.Cells),
+           Named("threadBusy") = gPairStats.ThreadBusy);
+}
 
-    vector<int> g1Common;  
-    set<int> revColcand(lcsTags[vecGenes[1]].begin(), lcsTags[vecGenes[1]].end());
-    for (auto i = 0; i < discreteInputData[vecGenes[0]].size() ;i++){
-      auto res = revColcand.find(discreteInputData[vecGenes[0]][i]);
-      if(res!=revColcand.end())
-        g1Common.push_back(discreteInputData[vecGenes[0]][i]);
-    }
-    #pragma omp parallel for default(shared)
-    for (auto ki = 0; ki < rowNumber; ki++) {
-      //vector for result from lcs with reversed input
-      int commonCnt=0;
-      for (auto i=0;i<colNumber;i++) {
-        if (discreteInputValues(vecGenes[0],i) * (discreteInputValues(ki,i)) != 0)
-          commonCnt++;
-      }
-      if(commonCnt< floor(colcand.size() * gParameters.Tolerance)) {
-        candidates[ki] = false;
-      }     
-    }
-    vector<int> g2Common;
-    vector<vector<int>> reveTag(rowNumber);
-    #pragma omp parallel for default(shared) private(g2Common)
-    for (auto ki = 0; ki < rowNumber; ki++) {
-      if(!candidates[ki])
-        continue;
-       //instersect second lcs input with lcs seed and calculate common vector
-      for (auto i = 0; i < discreteInputData[ki].size() ;i++){
-        auto res = revColcand.find(discreteInputData[ki][i]);
-        if(res!=revColcand.end())
-          g2Common.push_back(discreteInputData[ki][i]);
-      }
-      //reverse the second input
-      reverse(g2Common.begin(), g2Common.end());
-      //calculate the lcs
-      reveTag[ki] = getGenesFullLCS(g1Common, g2Common);
-      g2Common.clear();
-      // count number of occurances of candidates in results of lcs
-      m_ct[ki]= count_if(reveTag[ki].begin(), reveTag[ki].end(), [&](int k) { return colcand.find(k) != colcand.end();});
-    }
-   
-    for (auto ki = 0; ki < rowNumber; ki++) {
-      colChose=true;
-      //vector for result from lcs with reversed input
-      if(!candidates[ki])
-        continue;
-      //check if this candidate can be added
-      if (candidates[ki] && (m_ct[ki] >=countThreshold)) {
-        for(auto it=colcand.begin(); it != colcand.end();it++){
-          //calcualte columns statistics of candidate
-          int tmpcount = colsStat[*it];
-          if(find(reveTag[ki].begin(), reveTag[ki].end(), *it) != reveTag[ki].end())
-            tmpcount++;
-          if(tmpcount < floor(components * 0.1)-1) {
-            colChose = false;
-            break;
-          }
-        }
-        if(colChose==true) {
-          //add new gene
-          vecGenes.push_back(ki);
-          components++;
-          candidates[ki] = false;
-          //update column statistics
-          for(auto it=reveTag[ki].begin();it!=reveTag[ki].end();it++)
-          {      
-              colsStat[*it]++;
-          }
-        }
-      }
-    }
-    // save the current cluster
-    for (auto ki = 0; ki < currBlock->block_rows_pre; ki++)
-      vecBicGenes.push_back(vecGenes[ki]);
-
-    // add conditions to current bicluster
-    for (auto it = colcand.begin(); it!=colcand.end(); it++)
-        currBlock->conds.push_back(*it);
-    currBlock->block_cols = currBlock->conds.size();
-
-    // check the minimal requirements for bicluster
-    if (currBlock->block_cols < 4 || components < 5){
-      delete currBlock;
-      continue;      
-    }
-    currBlock->block_rows = components;
+Rcpp::List memoryToList(StageMemory const &memory) {
+  return List::create(
+           Named("input") = static_cast<double>(memory.Input),
+           Named("pairs") = static_cast<double>(memory.Pairs),
+           Named("cluster") = static_cast<double>(memory.Cluster),
+           Named("output") = static_cast<double>(memory.Output),
+           Named("streamPairs") = memory.StreamPairs);
+}
 
-    // update score of current bicluster
-    if (gParameters.IsPValue)
-      currBlock->score = -(100*log(currBlock->pvalue));
-    else
-      currBlock->score = currBlock->block_rows * currBlock->block_cols;
-
-    // add genes to current bicluster
-    currBlock->genes.clear();    
-    for (auto ki=0; ki < components; ki++){
-      currBlock->genes.push_back(vecGenes[ki]);
-      // update vector with all found genes
-      auto result1 = vecAllInCluster.find(vecGenes[ki]);
-      if(result1==vecAllInCluster.end())
-        vecAllInCluster.insert(vecGenes[ki]);
-    }
-    // add current block to vector
-    arrBlocks.push_back(currBlock);
+/* bytes of the matrices returned by fromBlocks */
+size_t resultBytes(const int numBlocks, const int nr, const int nc) {
+  return sizeof(int) * static_cast<size_t>(numBlocks) * (nr + nc);
+}
 
-    // check termination condition 
-    if (arrBlocks.size() == gParameters.SchBlock) 
-      break;
+void seedsFromVectors(Rcpp::IntegerVector scores, Rcpp::IntegerVector geneOne, Rcpp::IntegerVector geneTwo, std::vector<triple> &seeds) {
+  seeds.resize(scores.size());
+  for (size_t i = 0; i < seeds.size(); i++) {
+    seeds[i].geneA = geneOne(i);
+    seeds[i].geneB = geneTwo(i);
+    seeds[i].lcslen = scores(i);
   }
-  //------------------------------------------------------------------------------------------------------------------------------------
-  // Sorting and postprocessing of biclusters
-
-  stable_sort(arrBlocks.begin(), arrBlocks.end(), &blockComp);
-  int n = min(static_cast<int>(arrBlocks.size()), gParameters.RptBlock);
-  bool flag;
-
-  BicBlock **output = new BicBlock*[n]; // Array with filtered biclusters
-  BicBlock **bb_ptr = output;
-  BicBlock *b_ptr;
-
-  double cur_rows, cur_cols;
-  double inter_rows, inter_cols;
-
-  /* the major post-processing here, filter overlapping blocks*/
-  int i = 0, j = 0, k=0;
-  while (i < arrBlocks.size() && j < n) {
-    b_ptr = arrBlocks[i];
-    cur_rows = b_ptr->block_rows;
-    cur_cols = b_ptr->block_cols;
-    
-    flag = true;
-    k = 0;
-    while (k < j) {
-      inter_rows =0;
-      for(auto iter = output[k]->genes.begin(); iter != output[k]->genes.end(); iter++) {
-        auto result1 = find(b_ptr->genes.begin(), b_ptr->genes.end(), *iter);
-        if(result1!=b_ptr->genes.end()){
-          inter_rows++;
-        }
-      }
-      inter_cols=0;
-      for(auto iter = output[k]->conds.begin(); iter != output[k]->conds.end(); iter++) {
-        auto result1 = find(b_ptr->conds.begin(), b_ptr->conds.end(), *iter);
-        if(result1!=b_ptr->conds.end()){
-          inter_cols++;
-        }
-      }
-      if (inter_rows*inter_cols > gParameters.Filter*cur_rows*cur_cols) {
-        flag = FALSE;
-        break;
-      }
-      k++;
-    }
-    i++;
-    if (flag) {
-      // print_bc(fw, b_ptr, j++); file print
-      j++;
-      *bb_ptr++ = b_ptr;
-    }
-  }
-  List outList = fromBlocks(output, j, rowNumber, colNumber);
-  for(auto ind =0; ind<arrBlocks.size(); ind++)
-      delete arrBlocks[ind];
-  delete[] output;
-
-  return outList;
 }
-Rcpp::List fromBlocks(BicBlock ** blocks, const int numBlocks, const int nr, const int nc) {
+
+Rcpp::List fromBlocks(BicBlock ** blocks, const int numBlocks, const int nr, const int nc, Rcpp::List info) {
 
   auto x = LogicalMatrix(nr, numBlocks);
   auto y = LogicalMatrix(numBlocks, nc);
@@ -772,5 +1071,18 @@ Rcpp::List fromBlocks(BicBlock ** blocks, const int numBlocks, const int nr, con
            Named("RowxNumber") = x,
            Named("NumberxCol") = y,
            Named("Number") = numBlocks,
-           Named("info") = List::create());
+           Named("info") = info);
+}
+
+/* the counters of the lcs cache are reported only for settings clustered with one, i.e. by a sweep of several settings */
+Rcpp::List statsToList(ClusterStats const &stats, bool cached) {
+  if (!cached)
+    return List::create(
+             Named("seeds") = static_cast<double>(stats.Seeds),
+             Named("scratchBytes") = static_cast<double>(stats.ScratchBytes));
+  return List::create(
+           Named("seeds") = static_cast<double>(stats.Seeds),
+           Named("scratchBytes") = static_cast<double>(stats.ScratchBytes),
+           Named("tagCacheHits") = static_cast<double>(stats.TagHits),
+           Named("tagCacheMisses") = static_cast<double>(stats.TagMisses));
 }